@@ -16,3 +16,4 @@ TEMPLATE = app
 SOURCES += main.cpp
 
 include(../common.pri)
+include(../imaging/imaging.pri)
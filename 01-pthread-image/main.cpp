@@ -7,17 +7,27 @@
 #include <QVector>
 #include <thread>
 #include <iostream>
+#include <memory>
+
+#include "bench.h"
+#include "filter.h"
+#include "histogram.h"
+#include "pixel.h"
+#include "planar.h"
+#include "pngwriter.h"
+#include "stream.h"
 
 using namespace std;
 
 class work {
 public:
-    work() : n(1), rank(1), image(nullptr) {}
-    work(int _n, int _rank, QImage *_img) :
-        n(_n), rank(_rank), image(_img) { }
+    work() : n(1), rank(1), image(nullptr), adjust(pixel_adjust_scalar) {}
+    work(int _n, int _rank, QImage *_img, PixelAdjust _adjust) :
+        n(_n), rank(_rank), image(_img), adjust(_adjust) { }
     int n;
     int rank;
     QImage *image;
+    PixelAdjust adjust;
 };
 
 void *effect(void *arg)
@@ -33,33 +43,22 @@ void *effect(void *arg)
 
     int dr = (255 / wk->n * wk->rank) % 255;
     int dg = 0; int db = 0;
-    int r, g, b;
+    int width = img->width();
     for (int y = h0; y < h1; y++) {
         QRgb *line = (QRgb *) img->scanLine(y);
-        for (int x = 0; x < img->width(); x++) {
-            if (!img->valid(x, y)) {
-                qDebug() << QString("invalid (%1,%2)").arg(x).arg(y);
-            }
-            QRgb *rgb = line + x;
-
-            r = qBound(0, qRed(*rgb) + dr, 255);
-            g = qBound(0, qGreen(*rgb) + dg, 255);
-            b = qBound(0, qBlue(*rgb) + db, 255);
-
-            *rgb = qRgb(r, g, b);
-        }
+        wk->adjust(line, width, dr, dg, db);
     }
 
     return 0;
 }
 
-void processImage(QImage &image, int n)
+void processImage(QImage &image, int n, PixelAdjust adjust)
 {
     thread threads[n];
     work items[n];
 
     for (int i = 0; i < n; i++) {
-        items[i] = work{n, i, &image};
+        items[i] = work{n, i, &image, adjust};
         threads[i] = thread(effect, &items[i]);
     }
 
@@ -68,6 +67,268 @@ void processImage(QImage &image, int n)
     }
 }
 
+// static partition of the rows between n threads, thread i on cpu i if pinned
+FilterChain::RowExecutor threadExecutor(int n, bool pin = false)
+{
+    return [n, pin](int rows, const FilterChain::RowBody &body) {
+        vector<thread> threads;
+        for (int i = 0; i < n; i++) {
+            int y0 = rows * i / n;
+            int y1 = rows * (i + 1) / n;
+            threads.push_back(thread([&body, pin, i, y0, y1]() {
+                if (pin)
+                    pin_current_thread(i);
+                body(y0, y1);
+            }));
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+    };
+}
+
+// the encoding is parallel too, QImage::save() would be the serial tail of each run
+void savePng(const QImage &img, const QString &path, int threads)
+{
+    QElapsedTimer timer;
+    timer.start();
+    if (!write_png_parallel(path.toStdString(), (const uint32_t *) img.constBits(),
+                            img.width(), img.height(), img.bytesPerLine() / sizeof(QRgb),
+                            threadExecutor(threads))) {
+        qDebug() << "error saving image" << path;
+    }
+    qDebug() << "png encode:" << timer.nsecsElapsed();
+}
+
+/*
+ * Apply the filter chain once per stage (unfused) and with the point-wise
+ * stages fused, on a fresh copy of the image for each run.
+ */
+void benchmarkFilter(const QImage &image, const FilterChain &chain, int n, const QString &output)
+{
+    qDebug() << "filter passes:" << chain.passes();
+    QMap<int, qint64> results_unfused;
+    QMap<int, qint64> results_fused;
+    QElapsedTimer timer;
+    for (int cpus = 1; cpus <= n; cpus *= 2) {
+        qDebug() << "threads=" << cpus;
+        QImage img = image.copy();
+        timer.restart();
+        chain.applyUnfused((uint32_t *) img.bits(), img.width(), img.height(),
+                           img.bytesPerLine() / sizeof(QRgb), threadExecutor(cpus));
+        results_unfused[cpus] = timer.nsecsElapsed();
+
+        img = image.copy();
+        timer.restart();
+        chain.apply((uint32_t *) img.bits(), img.width(), img.height(),
+                    img.bytesPerLine() / sizeof(QRgb), threadExecutor(cpus));
+        results_fused[cpus] = timer.nsecsElapsed();
+        savePng(img, output + "." + QString::number(cpus) + ".png", cpus);
+    }
+
+    // report: threads;unfused;fused;unfused speedup;fused speedup
+    double baseline = results_unfused[1];
+    for (const int key : results_fused.keys()) {
+        cout << QString("%1;%2;%3;%4;%5")
+                .arg(key)
+                .arg(results_unfused[key])
+                .arg(results_fused[key])
+                .arg(baseline / results_unfused[key])
+                .arg(baseline / results_fused[key])
+                .toStdString() << endl;
+    }
+}
+
+/*
+ * Histogram equalisation (clip < 0) or auto levels: one sweep builds the
+ * histograms, the second applies the lookup table derived from them.
+ */
+void benchmarkEqualize(const QImage &image, double clip, int n, const QString &output)
+{
+    QMap<int, qint64> results_histogram;
+    QMap<int, qint64> results_apply;
+    QElapsedTimer timer;
+    for (int cpus = 1; cpus <= n; cpus *= 2) {
+        qDebug() << "threads=" << cpus;
+        QImage img = image.copy();
+        uint32_t *bits = (uint32_t *) img.bits();
+        int stride = img.bytesPerLine() / sizeof(QRgb);
+        Histogram hist;
+        uint8_t lut[3][256];
+        timer.restart();
+        histogram_build(bits, img.width(), img.height(), stride, hist, threadExecutor(cpus));
+        if (clip < 0)
+            equalize_lut(hist, lut);
+        else
+            levels_lut(hist, clip, lut);
+        results_histogram[cpus] = timer.nsecsElapsed();
+
+        FilterChain chain;
+        chain.lut(lut);
+        timer.restart();
+        chain.apply(bits, img.width(), img.height(), stride, threadExecutor(cpus));
+        results_apply[cpus] = timer.nsecsElapsed();
+        savePng(img, output + "." + QString::number(cpus) + ".png", cpus);
+    }
+
+    // report: threads;histogram;apply;total;speedup
+    double baseline = results_histogram[1] + results_apply[1];
+    for (const int key : results_histogram.keys()) {
+        qint64 total = results_histogram[key] + results_apply[key];
+        cout << QString("%1;%2;%3;%4;%5")
+                .arg(key)
+                .arg(results_histogram[key])
+                .arg(results_apply[key])
+                .arg(total)
+                .arg(baseline / total)
+                .toStdString() << endl;
+    }
+}
+
+/*
+ * Colour shift followed by grayscale, repeated passes times, on the packed
+ * image and on its planar copy. The planar timing includes the conversion
+ * to planes and back, paid once whatever the number of passes.
+ */
+void benchmarkPlanar(const QImage &image, int n, const QString &output)
+{
+    FilterChain::RowExecutor exec = threadExecutor(n);
+    PixelAdjust simd = pixel_adjust_best();
+    FilterChain gray;
+    gray.grayscale();
+    QElapsedTimer timer;
+    QImage img;
+    QMap<int, qint64> results_packed;
+    QMap<int, qint64> results_planar;
+    QMap<int, qint64> results_conversion;
+    for (int passes = 1; passes <= 16; passes *= 2) {
+        qDebug() << "passes=" << passes;
+        img = image.copy();
+        uint32_t *bits = (uint32_t *) img.bits();
+        int stride = img.bytesPerLine() / sizeof(QRgb);
+        timer.restart();
+        for (int i = 0; i < passes; i++) {
+            exec(img.height(), [&](int y0, int y1) {
+                for (int y = y0; y < y1; y++) {
+                    simd(bits + (size_t) y * stride, img.width(), 20, 0, -20);
+                }
+            });
+            gray.apply(bits, img.width(), img.height(), stride, exec);
+        }
+        results_packed[passes] = timer.nsecsElapsed();
+
+        img = image.copy();
+        bits = (uint32_t *) img.bits();
+        PlanarImage planes;
+        qint64 conversion = 0;
+        timer.restart();
+        planar_split(bits, img.width(), img.height(), stride, planes, exec);
+        conversion += timer.nsecsElapsed();
+        for (int i = 0; i < passes; i++) {
+            planar_shift(planes, 20, 0, -20, exec);
+            planar_grayscale(planes, exec);
+        }
+        qint64 split_done = timer.nsecsElapsed();
+        planar_merge(planes, bits, stride, exec);
+        results_planar[passes] = timer.nsecsElapsed();
+        results_conversion[passes] = conversion + results_planar[passes] - split_done;
+    }
+    savePng(img, output + ".planar.png", n);
+
+    // report: passes;packed;planar;conversion;planar speedup
+    for (const int key : results_packed.keys()) {
+        cout << QString("%1;%2;%3;%4;%5")
+                .arg(key)
+                .arg(results_packed[key])
+                .arg(results_planar[key])
+                .arg(results_conversion[key])
+                .arg((double) results_packed[key] / results_planar[key])
+                .toStdString() << endl;
+    }
+}
+
+/*
+ * Colour shift timed over warmup and measured trials for every thread count
+ * from 1 to n. Each trial processes a pristine copy of the image, made
+ * outside of the timed region.
+ */
+void benchmarkTrials(const QImage &image, int n, int warmups, int trials, bool pin)
+{
+    PixelAdjust kernels[] = { pixel_adjust_scalar, pixel_adjust_best() };
+    QImage img;
+    double baseline = 0;
+    cout << "threads,kernel," << trial_csv_header() << ",speedup" << endl;
+    for (int cpus = 1; cpus <= n; cpus++) {
+        FilterChain::RowExecutor exec = threadExecutor(cpus, pin);
+        for (PixelAdjust adjust : kernels) {
+            TrialStats stats = run_trials([&]() {
+                img = image.copy();
+            }, [&]() {
+                uint32_t *bits = (uint32_t *) img.bits();
+                int stride = img.bytesPerLine() / sizeof(QRgb);
+                exec(img.height(), [&](int y0, int y1) {
+                    for (int y = y0; y < y1; y++) {
+                        adjust(bits + (size_t) y * stride, img.width(), 20, 0, 0);
+                    }
+                });
+            }, warmups, trials);
+            if (baseline == 0)
+                baseline = stats.median;
+            cout << cpus << "," << pixel_adjust_name(adjust) << "," << trial_csv(stats)
+                 << "," << baseline / stats.median << endl;
+        }
+    }
+}
+
+/*
+ * Out of core processing: one strip at a time is decoded, filtered by n
+ * threads and encoded, the whole image is never in memory.
+ */
+bool streamImage(const QString &input, const QString &output, const FilterChain &chain,
+                 int strip_rows, int n)
+{
+    unique_ptr<StripReader> reader(StripReader::open(input.toStdString()));
+    if (!reader) {
+        qDebug() << "error opening image" << input;
+        return false;
+    }
+    unique_ptr<StripWriter> writer(StripWriter::create(output.toStdString(),
+                                                       reader->width(), reader->height()));
+    if (!writer) {
+        qDebug() << "error creating image" << output;
+        return false;
+    }
+
+    StripSource source(reader.get(), strip_rows, chain.halo());
+    Strip strip;
+    bool write_ok = true;
+    int strips = 0;
+    QElapsedTimer timer;
+    timer.start();
+    while (write_ok && source.next(strip)) {
+        chain.apply(strip.pixels.data(), strip.width, strip.total, strip.width, threadExecutor(n));
+        write_ok = writer->writeRows(strip.output(), strip.rows, strip.width);
+        strips++;
+    }
+    write_ok = write_ok && writer->finish();
+    qint64 elapsed = timer.nsecsElapsed();
+
+    if (source.failed() || !write_ok) {
+        qDebug() << "error streaming" << input << "to" << output;
+        return false;
+    }
+
+    // report: width;height;strips;threads;elapsed
+    cout << QString("%1;%2;%3;%4;%5")
+            .arg(reader->width())
+            .arg(reader->height())
+            .arg(strips)
+            .arg(n)
+            .arg(elapsed)
+            .toStdString() << endl;
+    return true;
+}
+
 int main(int argc, char *argv[])
 {
     QCoreApplication app(argc, argv);
@@ -81,6 +342,34 @@ int main(int argc, char *argv[])
     QCommandLineOption outOption("output", "output image", "output");
     parser.addOption(outOption);
 
+    QCommandLineOption filterOption("filter",
+            "filter chain, e.g. shift:20,0,0;gamma:2.2;gray;threshold:128;blur", "filter");
+    parser.addOption(filterOption);
+
+    QCommandLineOption equalizeOption("equalize",
+            "histogram equalisation or auto levels [ equalize | levels[:clip percent] ]", "equalize");
+    parser.addOption(equalizeOption);
+
+    QCommandLineOption planarOption("planar", "compare packed and planar point-wise filters");
+    parser.addOption(planarOption);
+
+    QCommandLineOption trialsOption("trials",
+            "measured trials per thread count, from 1 to all cpus, CSV output", "trials");
+    parser.addOption(trialsOption);
+
+    QCommandLineOption warmupOption("warmup", "warmup trials per thread count", "warmup", "2");
+    parser.addOption(warmupOption);
+
+    QCommandLineOption pinOption("pin", "bind each thread to a cpu");
+    parser.addOption(pinOption);
+
+    QCommandLineOption streamOption("stream",
+            "process the image by strips without loading it (PNG or PPM)");
+    parser.addOption(streamOption);
+
+    QCommandLineOption stripOption("strip", "rows per strip", "strip", "256");
+    parser.addOption(stripOption);
+
     parser.process(app);
 
     if (!parser.isSet(inOption)) {
@@ -98,6 +387,19 @@ int main(int argc, char *argv[])
     qDebug() << "output:" << output;
     qDebug() << "num cpus:" << n;
 
+    if (parser.isSet(streamOption)) {
+        FilterChain chain;
+        QString spec = parser.isSet(filterOption) ? parser.value(filterOption) : "shift:20,0,0";
+        if (!chain.parse(spec.toStdString())) {
+            qDebug() << "invalid filter" << spec;
+            return 1;
+        }
+        if (!parser.isSet(outOption)) {
+            output += ".png";
+        }
+        return streamImage(input, output, chain, qMax(1, parser.value(stripOption).toInt()), n) ? 0 : 1;
+    }
+
     QImage image;
     if (!image.load(input)) {
         qDebug() << "error loading image" << input;
@@ -105,25 +407,70 @@ int main(int argc, char *argv[])
     }
     image = image.convertToFormat(QImage::Format_RGB32);
 
+    FilterChain chain;
+    if (parser.isSet(planarOption)) {
+        benchmarkPlanar(image, n, output);
+        return 0;
+    }
+
+    if (parser.isSet(equalizeOption)) {
+        QStringList spec = parser.value(equalizeOption).split(':');
+        double clip = -1;
+        if (spec[0] == "levels") {
+            clip = spec.size() > 1 ? spec[1].toDouble() / 100 : 0.005;
+        } else if (spec[0] != "equalize") {
+            qDebug() << "invalid equalisation" << parser.value(equalizeOption);
+            return 1;
+        }
+        benchmarkEqualize(image, clip, n, output);
+        return 0;
+    }
+
+    if (parser.isSet(filterOption)) {
+        if (!chain.parse(parser.value(filterOption).toStdString())) {
+            qDebug() << "invalid filter" << parser.value(filterOption);
+            return 1;
+        }
+        benchmarkFilter(image, chain, n, output);
+        return 0;
+    }
+
+    if (parser.isSet(trialsOption)) {
+        benchmarkTrials(image, n, qMax(0, parser.value(warmupOption).toInt()),
+                        qMax(1, parser.value(trialsOption).toInt()), parser.isSet(pinOption));
+        return 0;
+    }
+
     // benchmark
+    PixelAdjust simd = pixel_adjust_best();
+    qDebug() << "simd:" << pixel_adjust_name(simd);
     QMap<int, qint64> results;
+    QMap<int, qint64> results_simd;
     QElapsedTimer timer;
     for (int cpus = 1; cpus <= n; cpus *= 2) {
         qDebug() << "threads=" << cpus;
+        QImage img = image.copy();
         timer.restart();
-        processImage(image, cpus);
+        processImage(img, cpus, pixel_adjust_scalar);
         results[cpus] = timer.nsecsElapsed();
-        image.save(output + "." + QString::number(cpus) + ".png");
+        img = image.copy();
+        timer.restart();
+        processImage(img, cpus, simd);
+        results_simd[cpus] = timer.nsecsElapsed();
+        savePng(img, output + "." + QString::number(cpus) + ".png", cpus);
     }
 
-    // report
+    // report: threads;scalar;simd;scalar speedup;simd speedup
     double baseline = results[1];
     for (const int key : results.keys()) {
         double speedup = baseline / results[key];
-        cout << QString("%1;%2;%3")
+        double speedup_simd = baseline / results_simd[key];
+        cout << QString("%1;%2;%3;%4;%5")
                 .arg(key)
                 .arg(results[key])
+                .arg(results_simd[key])
                 .arg(speedup)
+                .arg(speedup_simd)
                 .toStdString() << endl;
     }
 
@@ -7,10 +7,27 @@ CONFIG -= app_bundle
 
 TEMPLATE = app
 
-SOURCES += main.cpp
+SOURCES += main.cpp \
+    steal_pool.cpp
 
-HEADERS += tp.h
+HEADERS += tp.h \
+    trace.h \
+    cost_range.h \
+    steal_pool.h
 
-LIBS += -ltbb -llttng-ust -ldl
+QMAKE_CXXFLAGS += -fopenmp
+QMAKE_LFLAGS += -fopenmp
+
+LIBS += -ltbb
+
+# LTTng-UST when available, the in-process ring buffer tracer otherwise
+# (DISPATCH_TRACE=file.json ./02-dispatch writes Chrome trace events)
+packagesExist(lttng-ust):!ringtrace {
+    DEFINES += DISPATCH_LTTNG
+    LIBS += -llttng-ust -ldl
+} else {
+    SOURCES += ringtrace.cpp
+    HEADERS += ringtrace.h
+}
 
 include(../common.pri)
@@ -0,0 +1,96 @@
+#ifndef COST_RANGE_H
+#define COST_RANGE_H
+
+#include <functional>
+#include <vector>
+#include <tbb/tbb.h>
+
+/*
+ * Split of an index range at equal cost points instead of equal lengths.
+ * The cost model is the cumulative cost of [0, x), non decreasing, so that
+ * the cost of [x0, x1) is cost(x1) - cost(x0). A split point is found by a
+ * binary search on the cumulative cost.
+ */
+typedef std::function<double (int)> cumulative_cost;
+
+// smallest x in [begin, end] such that cost(x) - cost(begin) >= fraction of the total
+inline int cost_split_point(const cumulative_cost &cost, int begin, int end, double fraction)
+{
+    double target = cost(begin) + fraction * (cost(end) - cost(begin));
+    int lo = begin;
+    int hi = end;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (cost(mid) < target)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// bounds of n contiguous chunks of equal cost, chunk i is [bounds[i], bounds[i + 1])
+inline std::vector<int> cost_partition(const cumulative_cost &cost, int begin, int end, int n)
+{
+    std::vector<int> bounds(n + 1);
+    bounds[0] = begin;
+    bounds[n] = end;
+    for (int i = 1; i < n; i++) {
+        bounds[i] = cost_split_point(cost, begin, end, (double) i / n);
+    }
+    return bounds;
+}
+
+/*
+ * TBB range splitting at equal cost. It is divisible while its cost is
+ * above grain, and supports proportional splits so that with
+ * tbb::static_partitioner each thread gets one chunk of the same cost,
+ * without the scheduling overhead of fine grain chunks.
+ */
+class cost_range {
+public:
+    static const bool is_splittable_in_proportion = true;
+
+    cost_range(int begin, int end, const cumulative_cost &cost, double grain = 0) :
+        m_begin(begin), m_end(end), m_cost(cost), m_grain(grain) { }
+
+    cost_range(cost_range &r, tbb::split) :
+        m_begin(0), m_end(r.m_end), m_cost(r.m_cost), m_grain(r.m_grain)
+    {
+        m_begin = r.split_at(0.5);
+    }
+
+    cost_range(cost_range &r, tbb::proportional_split &p) :
+        m_begin(0), m_end(r.m_end), m_cost(r.m_cost), m_grain(r.m_grain)
+    {
+        m_begin = r.split_at((double) p.left() / (p.left() + p.right()));
+    }
+
+    int begin() const { return m_begin; }
+    int end() const { return m_end; }
+    bool empty() const { return m_begin >= m_end; }
+    bool is_divisible() const
+    {
+        return m_end - m_begin > 1 && m_cost(m_end) - m_cost(m_begin) > m_grain;
+    }
+
+private:
+    // keep [begin, x) and return x, both parts are non empty
+    int split_at(double fraction)
+    {
+        int x = cost_split_point(m_cost, m_begin, m_end, fraction);
+        if (x <= m_begin)
+            x = m_begin + 1;
+        if (x >= m_end)
+            x = m_end - 1;
+        m_end = x;
+        return x;
+    }
+
+    int m_begin;
+    int m_end;
+    cumulative_cost m_cost;
+    double m_grain;
+};
+
+#endif // COST_RANGE_H
@@ -6,10 +6,14 @@
 #include <functional>
 #include <iostream>
 #include <tbb/tbb.h>
+#include <omp.h>
+
+#include "cost_range.h"
+#include "steal_pool.h"
 
 #define TRACEPOINT_CREATE_PROBES
 #define TRACEPOINT_DEFINE
-#include "tp.h"
+#include "trace.h"
 
 using namespace std;
 
@@ -77,10 +81,54 @@ int main()
         });
     });
 
+    // cumulative cost of prefix_range(0, x), prefix_sum(i) loops i times
+    cumulative_cost cost = [](int x) { return (double) x * (x - 1) / 2 + x; };
+
+    double balanced = elapsed([&](){
+        int n = thread::hardware_concurrency();
+        vector<int> bounds = cost_partition(cost, 0, range_max, n);
+        vector<thread> t;
+        for (int i = 0; i < n; i++) {
+            t.push_back(thread(prefix_range, bounds[i], bounds[i + 1]));
+        }
+
+        for (int i = 0; i < n; i++) {
+            t[i].join();
+        }
+    });
+
+    double cost_tbb = elapsed([&](){
+        tbb::parallel_for(cost_range(0, range_max, cost),
+            [&] (const cost_range& range) {
+                prefix_range(range.begin(), range.end());
+        }, tbb::static_partitioner());
+    });
+
+    double cost_omp = elapsed([&](){
+        int n = omp_get_max_threads();
+        vector<int> bounds = cost_partition(cost, 0, range_max, n);
+        #pragma omp parallel for schedule(static, 1)
+        for (int i = 0; i < n; i++) {
+            prefix_range(bounds[i], bounds[i + 1]);
+        }
+    });
+
+    StealPool pool;
+    double stealing = elapsed([&](){
+        pool.parallel_for(0, range_max, 64, prefix_range);
+    });
+    StealPool::Stats stats = pool.stats();
+
     // report
     print_result("serial", serial, serial);
     print_result("fixed", serial, fixed);
     print_result("dynamic", serial, dynamic);
+    print_result("balanced", serial, balanced);
+    print_result("cost tbb", serial, cost_tbb);
+    print_result("cost omp", serial, cost_omp);
+    print_result("stealing", serial, stealing);
+    qDebug() << "stealing:" << pool.size() << "workers" << stats.steals << "steals"
+             << stats.failed_steals << "failed" << stats.parks << "parks";
     return 0;
 }
 
@@ -0,0 +1,173 @@
+#include "ringtrace.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+static const size_t RING_SIZE = 1 << 16;
+
+struct RingRecord {
+    uint64_t ticks;
+    int32_t event;
+    int32_t begin;
+    int32_t end;
+    int32_t color;
+};
+
+struct RingBuffer {
+    int id;
+    long tid;
+    // written by the owner thread only, read at exit
+    atomic<uint64_t> head;
+    RingRecord records[RING_SIZE];
+};
+
+static inline uint64_t ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static uint64_t monotonic_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Registry of the ring buffers, one per thread that recorded an event. The
+ * buffers live until exit, after their thread is gone, and are flushed by
+ * the destructor of the static instance.
+ */
+class RingTracer {
+public:
+    RingTracer();
+    ~RingTracer();
+    bool enabled() const { return m_enabled; }
+    RingBuffer *attach();
+
+private:
+    void flush();
+
+    bool m_enabled;
+    string m_path;
+    uint64_t m_ticks0;
+    uint64_t m_ns0;
+    mutex m_lock;
+    vector<unique_ptr<RingBuffer>> m_buffers;
+};
+
+static RingTracer tracer;
+static thread_local RingBuffer *ring = nullptr;
+
+RingTracer::RingTracer() : m_enabled(false), m_ticks0(0), m_ns0(0)
+{
+    const char *path = getenv("DISPATCH_TRACE");
+    if (path && *path) {
+        m_enabled = true;
+        m_path = path;
+        m_ns0 = monotonic_ns();
+        m_ticks0 = ticks();
+    }
+}
+
+RingTracer::~RingTracer()
+{
+    if (m_enabled)
+        flush();
+}
+
+RingBuffer *RingTracer::attach()
+{
+    lock_guard<mutex> guard(m_lock);
+    unique_ptr<RingBuffer> buffer(new RingBuffer());
+    buffer->id = m_buffers.size();
+    buffer->tid = syscall(SYS_gettid);
+    buffer->head = 0;
+    m_buffers.push_back(move(buffer));
+    return m_buffers.back().get();
+}
+
+void ringtrace_record(RingEvent event, int begin, int end, int color)
+{
+    if (!tracer.enabled())
+        return;
+    if (ring == nullptr)
+        ring = tracer.attach();
+    uint64_t head = ring->head.load(memory_order_relaxed);
+    RingRecord &r = ring->records[head % RING_SIZE];
+    r.ticks = ticks();
+    r.event = event;
+    r.begin = begin;
+    r.end = end;
+    r.color = color;
+    ring->head.store(head + 1, memory_order_release);
+}
+
+void RingTracer::flush()
+{
+    uint64_t ns1 = monotonic_ns();
+    uint64_t ticks1 = ticks();
+    double ns_per_tick = ticks1 > m_ticks0 ? (double) (ns1 - m_ns0) / (ticks1 - m_ticks0) : 1.0;
+
+    FILE *out = fopen(m_path.c_str(), "w");
+    if (out == nullptr) {
+        perror(m_path.c_str());
+        return;
+    }
+
+    lock_guard<mutex> guard(m_lock);
+    int pid = getpid();
+    const char *sep = "";
+    uint64_t lost = 0;
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (const unique_ptr<RingBuffer> &buffer : m_buffers) {
+        fprintf(out, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,"
+                "\"args\":{\"name\":\"thread %d (%ld)\"}}",
+                sep, pid, buffer->id, buffer->id, buffer->tid);
+        sep = ",";
+
+        uint64_t head = buffer->head.load(memory_order_acquire);
+        uint64_t first = head > RING_SIZE ? head - RING_SIZE : 0;
+        lost += first;
+        bool open = false;
+        for (uint64_t i = first; i < head; i++) {
+            const RingRecord &r = buffer->records[i % RING_SIZE];
+            // timestamps in microseconds since startup
+            double ts = ((int64_t) (r.ticks - m_ticks0)) * ns_per_tick / 1000.0;
+            if (r.event == RING_ENTRY) {
+                fprintf(out, ",\n{\"ph\":\"B\",\"name\":\"chunk\",\"cat\":\"dispatch\",\"pid\":%d,"
+                        "\"tid\":%d,\"ts\":%.3f,\"args\":{\"begin\":%d,\"end\":%d,\"color\":%d}}",
+                        pid, buffer->id, ts, r.begin, r.end, r.color);
+                open = true;
+            } else if (open) {
+                // an exit whose entry was overwritten is dropped
+                fprintf(out, ",\n{\"ph\":\"E\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f}",
+                        pid, buffer->id, ts);
+                open = false;
+            }
+        }
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    fprintf(stderr, "ringtrace: %zu threads written to %s, %llu records overwritten\n",
+            m_buffers.size(), m_path.c_str(), (unsigned long long) lost);
+}
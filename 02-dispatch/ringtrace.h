@@ -0,0 +1,31 @@
+#ifndef RINGTRACE_H
+#define RINGTRACE_H
+
+#include <cstdint>
+
+/*
+ * In-process tracer for hosts without LTTng. Each thread appends timestamped
+ * records to its own ring buffer without locking, the oldest records are
+ * overwritten when it is full. At exit the buffers are written as Chrome
+ * trace events (chrome://tracing, Perfetto) to the file named by the
+ * DISPATCH_TRACE environment variable. Without it nothing is recorded.
+ *
+ * Timestamps are TSC ticks on x86, converted to time with the TSC and
+ * CLOCK_MONOTONIC sampled at startup and at exit.
+ */
+enum RingEvent { RING_ENTRY, RING_EXIT };
+
+void ringtrace_record(RingEvent event, int begin, int end, int color);
+
+// events of the dispatch provider, see tp.h
+inline void dispatch_entry(int begin, int end, int color)
+{
+    ringtrace_record(RING_ENTRY, begin, end, color);
+}
+
+inline void dispatch_exit()
+{
+    ringtrace_record(RING_EXIT, 0, 0, 0);
+}
+
+#endif // RINGTRACE_H
@@ -0,0 +1,248 @@
+#include "steal_pool.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <immintrin.h>
+
+using namespace std;
+
+// spins of an idle worker before parking
+static const int SPIN = 2000;
+
+static inline uint64_t make_task(int begin, int end)
+{
+    return ((uint64_t) (uint32_t) begin << 32) | (uint32_t) end;
+}
+
+static inline int task_begin(uint64_t task) { return (int) (task >> 32); }
+static inline int task_end(uint64_t task) { return (int) (uint32_t) task; }
+
+bool ChaseLevDeque::push(uint64_t task)
+{
+    long b = m_bottom.load(memory_order_relaxed);
+    long t = m_top.load(memory_order_acquire);
+    if (b - t >= CAPACITY)
+        return false;
+    m_buffer[b % CAPACITY].store(task, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    m_bottom.store(b + 1, memory_order_relaxed);
+    return true;
+}
+
+bool ChaseLevDeque::pop(uint64_t &task)
+{
+    long b = m_bottom.load(memory_order_relaxed) - 1;
+    m_bottom.store(b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = m_top.load(memory_order_relaxed);
+    if (t > b) {
+        // empty
+        m_bottom.store(b + 1, memory_order_relaxed);
+        return false;
+    }
+    task = m_buffer[b % CAPACITY].load(memory_order_relaxed);
+    if (t == b) {
+        // last one, race against the thieves
+        bool won = m_top.compare_exchange_strong(t, t + 1, memory_order_seq_cst,
+                                                 memory_order_relaxed);
+        m_bottom.store(b + 1, memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+bool ChaseLevDeque::steal(uint64_t &task)
+{
+    long t = m_top.load(memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = m_bottom.load(memory_order_acquire);
+    if (t >= b)
+        return false;
+    task = m_buffer[t % CAPACITY].load(memory_order_relaxed);
+    return m_top.compare_exchange_strong(t, t + 1, memory_order_seq_cst,
+                                         memory_order_relaxed);
+}
+
+bool ChaseLevDeque::empty() const
+{
+    return m_bottom.load(memory_order_relaxed) <= m_top.load(memory_order_relaxed);
+}
+
+void *StealPool::Worker::operator new(size_t size)
+{
+    void *p;
+    if (posix_memalign(&p, alignof(Worker), size) != 0)
+        throw bad_alloc();
+    return p;
+}
+
+void StealPool::Worker::operator delete(void *p)
+{
+    free(p);
+}
+
+StealPool::StealPool(int n) :
+    m_body(nullptr), m_grain(1), m_remaining(0), m_stop(false), m_sleepers(0)
+{
+    for (int i = 0; i < max(n, 1); i++) {
+        unique_ptr<Worker> worker(new Worker());
+        worker->seed = 0x9e3779b97f4a7c15ULL * (i + 1);
+        m_workers.push_back(move(worker));
+    }
+    resetStats();
+    for (size_t i = 1; i < m_workers.size(); i++) {
+        m_workers[i]->thread = thread(&StealPool::workerLoop, this, i);
+    }
+}
+
+StealPool::~StealPool()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stop.store(true);
+    }
+    m_wakeup.notify_all();
+    for (size_t i = 1; i < m_workers.size(); i++) {
+        m_workers[i]->thread.join();
+    }
+}
+
+void StealPool::parallel_for(int begin, int end, int grain, const Body &body)
+{
+    if (begin >= end)
+        return;
+    m_body = &body;
+    m_grain = max(grain, 1);
+    m_remaining.store(end - begin);
+
+    // the workers see the body and grain through the release of the push
+    uint64_t task = make_task(begin, end);
+    if (!m_workers[0]->deque.push(task)) {
+        execute(0, task);
+        return;
+    }
+    atomic_thread_fence(memory_order_seq_cst);
+    if (m_sleepers.load(memory_order_relaxed) > 0) {
+        lock_guard<mutex> lock(m_mutex);
+        m_wakeup.notify_all();
+    }
+
+    while (m_remaining.load(memory_order_acquire) > 0) {
+        if (findTask(0, task))
+            execute(0, task);
+        else
+            _mm_pause();
+    }
+}
+
+// own deque first, then random victims
+bool StealPool::findTask(int id, uint64_t &task)
+{
+    Worker &self = *m_workers[id];
+    if (self.deque.pop(task))
+        return true;
+    int n = m_workers.size();
+    for (int i = 0; i < n - 1; i++) {
+        // xorshift64
+        self.seed ^= self.seed << 13;
+        self.seed ^= self.seed >> 7;
+        self.seed ^= self.seed << 17;
+        int victim = self.seed % n;
+        if (victim == id)
+            continue;
+        if (m_workers[victim]->deque.steal(task)) {
+            self.steals.fetch_add(1, memory_order_relaxed);
+            return true;
+        }
+        self.failed_steals.fetch_add(1, memory_order_relaxed);
+    }
+    return false;
+}
+
+// split down to the grain, the right halves are left for the thieves
+void StealPool::execute(int id, uint64_t task)
+{
+    int begin = task_begin(task);
+    int end = task_end(task);
+    while (end - begin > m_grain) {
+        int mid = begin + (end - begin) / 2;
+        if (!m_workers[id]->deque.push(make_task(mid, end)))
+            break;
+        wakeOne();
+        end = mid;
+    }
+    (*m_body)(begin, end);
+    m_remaining.fetch_sub(end - begin, memory_order_acq_rel);
+}
+
+void StealPool::workerLoop(int id)
+{
+    int idle = 0;
+    uint64_t task;
+    while (!m_stop.load(memory_order_acquire)) {
+        if (findTask(id, task)) {
+            execute(id, task);
+            idle = 0;
+        } else if (++idle < SPIN) {
+            _mm_pause();
+        } else {
+            park(id);
+            idle = 0;
+        }
+    }
+}
+
+/*
+ * The sleeper count is incremented before checking the deques, and pushers
+ * check it after pushing, so one of the two sees the other. The timeout is
+ * a safety net, not the wakeup mechanism.
+ */
+void StealPool::park(int id)
+{
+    unique_lock<mutex> lock(m_mutex);
+    m_sleepers.fetch_add(1, memory_order_seq_cst);
+    if (!m_stop.load() && !workAvailable()) {
+        m_workers[id]->parks.fetch_add(1, memory_order_relaxed);
+        m_wakeup.wait_for(lock, chrono::milliseconds(10));
+    }
+    m_sleepers.fetch_sub(1, memory_order_relaxed);
+}
+
+void StealPool::wakeOne()
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (m_sleepers.load(memory_order_relaxed) > 0) {
+        lock_guard<mutex> lock(m_mutex);
+        m_wakeup.notify_one();
+    }
+}
+
+bool StealPool::workAvailable() const
+{
+    for (const unique_ptr<Worker> &worker : m_workers) {
+        if (!worker->deque.empty())
+            return true;
+    }
+    return false;
+}
+
+StealPool::Stats StealPool::stats() const
+{
+    Stats stats = Stats();
+    for (const unique_ptr<Worker> &worker : m_workers) {
+        stats.steals += worker->steals.load();
+        stats.failed_steals += worker->failed_steals.load();
+        stats.parks += worker->parks.load();
+    }
+    return stats;
+}
+
+void StealPool::resetStats()
+{
+    for (unique_ptr<Worker> &worker : m_workers) {
+        worker->steals = 0;
+        worker->failed_steals = 0;
+        worker->parks = 0;
+    }
+}
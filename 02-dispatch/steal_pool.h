@@ -0,0 +1,93 @@
+#ifndef STEAL_POOL_H
+#define STEAL_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Chase-Lev work-stealing deque of ranges, in the C11 formulation of Le,
+ * Pop, Cohen and Zappa Nardelli (PPoPP 2013). The owner pushes and pops at
+ * the bottom, thieves steal at the top with a CAS. The capacity is fixed:
+ * ranges are split in halves, so the depth is about log2(n / grain).
+ */
+class ChaseLevDeque {
+public:
+    static const int CAPACITY = 256;
+
+    ChaseLevDeque() : m_top(0), m_bottom(0) { }
+    bool push(uint64_t task);
+    bool pop(uint64_t &task);
+    bool steal(uint64_t &task);
+    bool empty() const;
+
+private:
+    alignas(64) std::atomic<long> m_top;
+    alignas(64) std::atomic<long> m_bottom;
+    std::atomic<uint64_t> m_buffer[CAPACITY];
+};
+
+/*
+ * Work-stealing pool with a parallel_for interface. The range is split in
+ * halves down to the grain, the worker keeps the left half and pushes the
+ * right half on its deque, where idle workers steal it from a randomly
+ * chosen victim. Idle workers spin for a while, then park until new work
+ * is pushed. The calling thread is worker 0.
+ *
+ * One parallel_for at a time, the body must not call parallel_for.
+ */
+class StealPool {
+public:
+    typedef std::function<void (int, int)> Body;
+
+    struct Stats {
+        uint64_t steals;
+        uint64_t failed_steals;
+        uint64_t parks;
+    };
+
+    explicit StealPool(int n = std::thread::hardware_concurrency());
+    ~StealPool();
+
+    void parallel_for(int begin, int end, int grain, const Body &body);
+    int size() const { return m_workers.size(); }
+    Stats stats() const;
+    void resetStats();
+
+private:
+    struct alignas(64) Worker {
+        ChaseLevDeque deque;
+        std::atomic<uint64_t> steals;
+        std::atomic<uint64_t> failed_steals;
+        std::atomic<uint64_t> parks;
+        uint64_t seed;
+        std::thread thread;
+
+        // plain new ignores the alignment before C++17
+        static void *operator new(size_t size);
+        static void operator delete(void *p);
+    };
+
+    bool findTask(int id, uint64_t &task);
+    void execute(int id, uint64_t task);
+    void workerLoop(int id);
+    void park(int id);
+    void wakeOne();
+    bool workAvailable() const;
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    const Body *m_body;
+    int m_grain;
+    std::atomic<long> m_remaining;
+    std::atomic<bool> m_stop;
+    std::atomic<int> m_sleepers;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+};
+
+#endif // STEAL_POOL_H
@@ -0,0 +1,16 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * The dispatch tracepoints go to LTTng-UST when built with DISPATCH_LTTNG,
+ * otherwise to the in-process ring buffer tracer. Both are used through
+ * tracepoint(dispatch, entry, begin, end, color) and tracepoint(dispatch, exit).
+ */
+#ifdef DISPATCH_LTTNG
+#include "tp.h"
+#else
+#include "ringtrace.h"
+#define tracepoint(provider, name, ...) provider##_##name(__VA_ARGS__)
+#endif
+
+#endif // TRACE_H
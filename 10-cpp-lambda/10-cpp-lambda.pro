@@ -16,4 +16,6 @@ CONFIG += C++11
 TEMPLATE = app
 
 
+LIBS += -ltbb
+
 SOURCES += main.cpp
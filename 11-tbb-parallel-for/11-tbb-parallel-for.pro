@@ -16,4 +16,9 @@ CONFIG   += c++11
 TEMPLATE = app
 LIBS += -ltbb
 
-SOURCES += main.cpp
+SOURCES += main.cpp \
+    bulk.cpp
+
+HEADERS += bulk.h
+
+include(../tbbtune/tbbtune.pri)
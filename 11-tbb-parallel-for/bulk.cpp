@@ -0,0 +1,277 @@
+#include "bulk.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <immintrin.h>
+#include <tbb/tbb.h>
+
+using namespace std;
+
+static const size_t LINE = 64;
+// waking the workers costs more than a serial memset below this size
+static const size_t SERIAL_MAX = 256 * 1024;
+
+static size_t detect_llc()
+{
+    long size = 0;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (size <= 0)
+        size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    // the last index listed in sysfs is the last level
+    for (int i = 0; size <= 0 && i < 8; i++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", 7 - i);
+        FILE *f = fopen(path, "r");
+        if (!f)
+            continue;
+        long kb;
+        if (fscanf(f, "%ldK", &kb) == 1)
+            size = kb * 1024;
+        fclose(f);
+    }
+    return size > 0 ? size : 8 << 20;
+}
+
+size_t bulk_llc_size()
+{
+    static const size_t size = detect_llc();
+    return size;
+}
+
+/*
+ * The threshold is half the cache: the other threads and the source of a
+ * copy compete for the rest.
+ */
+BulkStrategy bulk_choose(size_t bytes)
+{
+    if (bytes <= SERIAL_MAX)
+        return BULK_SERIAL;
+    if (bytes <= bulk_llc_size() / 2)
+        return BULK_STORE;
+    return BULK_STREAM;
+}
+
+const char *bulk_strategy_name(BulkStrategy strategy)
+{
+    switch (strategy) {
+    case BULK_AUTO: return "auto";
+    case BULK_SERIAL: return "serial";
+    case BULK_STORE: return "store";
+    case BULK_STREAM: return "stream";
+    }
+    return "?";
+}
+
+const char *bulk_partitioner_name(BulkPartitioner partitioner)
+{
+    switch (partitioner) {
+    case BULK_SIMPLE: return "simple";
+    case BULK_AUTOPART: return "auto";
+    case BULK_AFFINITY: return "affinity";
+    }
+    return "?";
+}
+
+static bool has_avx()
+{
+    static const bool avx = __builtin_cpu_supports("avx");
+    return avx;
+}
+
+/*
+ * Streaming kernels, p is aligned on a cache line and bytes is a multiple
+ * of it. Non-temporal stores are weakly ordered, the sfence makes them
+ * visible before the task completes.
+ */
+static void fill_stream_sse2(uint8_t *p, uint8_t value, size_t bytes)
+{
+    __m128i v = _mm_set1_epi8(value);
+    for (size_t i = 0; i < bytes; i += LINE) {
+        _mm_stream_si128((__m128i *) (p + i), v);
+        _mm_stream_si128((__m128i *) (p + i + 16), v);
+        _mm_stream_si128((__m128i *) (p + i + 32), v);
+        _mm_stream_si128((__m128i *) (p + i + 48), v);
+    }
+    _mm_sfence();
+}
+
+__attribute__((target("avx")))
+static void fill_stream_avx(uint8_t *p, uint8_t value, size_t bytes)
+{
+    __m256i v = _mm256_set1_epi8(value);
+    for (size_t i = 0; i < bytes; i += LINE) {
+        _mm256_stream_si256((__m256i *) (p + i), v);
+        _mm256_stream_si256((__m256i *) (p + i + 32), v);
+    }
+    _mm_sfence();
+}
+
+static void copy_stream_sse2(uint8_t *dst, const uint8_t *src, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i += LINE) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *) (src + i + 32));
+        __m128i d = _mm_loadu_si128((const __m128i *) (src + i + 48));
+        _mm_stream_si128((__m128i *) (dst + i), a);
+        _mm_stream_si128((__m128i *) (dst + i + 16), b);
+        _mm_stream_si128((__m128i *) (dst + i + 32), c);
+        _mm_stream_si128((__m128i *) (dst + i + 48), d);
+    }
+    _mm_sfence();
+}
+
+__attribute__((target("avx")))
+static void copy_stream_avx(uint8_t *dst, const uint8_t *src, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i += LINE) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (src + i + 32));
+        _mm256_stream_si256((__m256i *) (dst + i), a);
+        _mm256_stream_si256((__m256i *) (dst + i + 32), b);
+    }
+    _mm_sfence();
+}
+
+static void iota_stream_sse2(int *p, size_t n, int start)
+{
+    __m128i v = _mm_setr_epi32(start, start + 1, start + 2, start + 3);
+    __m128i four = _mm_set1_epi32(4);
+    for (size_t i = 0; i < n; i += 4) {
+        _mm_stream_si128((__m128i *) (p + i), v);
+        v = _mm_add_epi32(v, four);
+    }
+    _mm_sfence();
+}
+
+static void iota_store(int *p, size_t n, int start)
+{
+    for (size_t i = 0; i < n; i++) {
+        p[i] = start + (int) i;
+    }
+}
+
+/*
+ * Calls body(first, last) over the cache lines [0, lines) in parallel.
+ * The affinity partitioner is static, one per body type and thus one per
+ * operation, so that repeated calls on the same buffer replay the mapping
+ * of the chunks to the threads. Operations of the same kind must not run
+ * concurrently with BULK_AFFINITY.
+ */
+template<typename Body>
+static void run_lines(size_t lines, const BulkConfig &config, const Body &body)
+{
+    size_t grain = max<size_t>(config.grain / LINE, 1);
+    tbb::blocked_range<size_t> range(0, lines, grain);
+    auto chunk = [&](const tbb::blocked_range<size_t> &r) {
+        body(r.begin(), r.end());
+    };
+    switch (config.partitioner) {
+    case BULK_SIMPLE:
+        tbb::parallel_for(range, chunk, tbb::simple_partitioner());
+        break;
+    case BULK_AFFINITY: {
+        static tbb::affinity_partitioner affinity;
+        tbb::parallel_for(range, chunk, affinity);
+        break;
+    }
+    default:
+        tbb::parallel_for(range, chunk, tbb::auto_partitioner());
+        break;
+    }
+}
+
+// bytes before the first cache line boundary
+static size_t head_bytes(const void *p, size_t bytes)
+{
+    return min(bytes, (LINE - (uintptr_t) p % LINE) % LINE);
+}
+
+void bulk_fill(void *dst, uint8_t value, size_t bytes, const BulkConfig &config)
+{
+    BulkStrategy strategy = config.strategy == BULK_AUTO ? bulk_choose(bytes) : config.strategy;
+    if (strategy == BULK_SERIAL) {
+        memset(dst, value, bytes);
+        return;
+    }
+
+    uint8_t *p = (uint8_t *) dst;
+    size_t head = head_bytes(p, bytes);
+    size_t lines = (bytes - head) / LINE;
+    uint8_t *aligned = p + head;
+    memset(p, value, head);
+    memset(aligned + lines * LINE, value, bytes - head - lines * LINE);
+
+    bool avx = has_avx();
+    run_lines(lines, config, [=](size_t first, size_t last) {
+        uint8_t *q = aligned + first * LINE;
+        size_t len = (last - first) * LINE;
+        if (strategy == BULK_STORE)
+            memset(q, value, len);
+        else if (avx)
+            fill_stream_avx(q, value, len);
+        else
+            fill_stream_sse2(q, value, len);
+    });
+}
+
+void bulk_copy(void *dst, const void *src, size_t bytes, const BulkConfig &config)
+{
+    // both buffers are in the working set
+    BulkStrategy strategy = config.strategy == BULK_AUTO ? bulk_choose(2 * bytes) : config.strategy;
+    if (strategy == BULK_SERIAL) {
+        memcpy(dst, src, bytes);
+        return;
+    }
+
+    // the destination is aligned, the loads from the source may not be
+    uint8_t *d = (uint8_t *) dst;
+    const uint8_t *s = (const uint8_t *) src;
+    size_t head = head_bytes(d, bytes);
+    size_t lines = (bytes - head) / LINE;
+    size_t tail = head + lines * LINE;
+    memcpy(d, s, head);
+    memcpy(d + tail, s + tail, bytes - tail);
+
+    bool avx = has_avx();
+    run_lines(lines, config, [=](size_t first, size_t last) {
+        uint8_t *q = d + head + first * LINE;
+        const uint8_t *r = s + head + first * LINE;
+        size_t len = (last - first) * LINE;
+        if (strategy == BULK_STORE)
+            memcpy(q, r, len);
+        else if (avx)
+            copy_stream_avx(q, r, len);
+        else
+            copy_stream_sse2(q, r, len);
+    });
+}
+
+void bulk_iota(int *dst, size_t n, int start, const BulkConfig &config)
+{
+    size_t bytes = n * sizeof(int);
+    BulkStrategy strategy = config.strategy == BULK_AUTO ? bulk_choose(bytes) : config.strategy;
+    if (strategy == BULK_SERIAL) {
+        iota_store(dst, n, start);
+        return;
+    }
+
+    const size_t per_line = LINE / sizeof(int);
+    size_t head = head_bytes(dst, bytes) / sizeof(int);
+    size_t lines = (n - head) / per_line;
+    size_t tail = head + lines * per_line;
+    iota_store(dst, head, start);
+    iota_store(dst + tail, n - tail, start + (int) tail);
+
+    run_lines(lines, config, [=](size_t first, size_t last) {
+        size_t i = head + first * per_line;
+        if (strategy == BULK_STORE)
+            iota_store(dst + i, (last - first) * per_line, start + (int) i);
+        else
+            iota_stream_sse2(dst + i, (last - first) * per_line, start + (int) i);
+    });
+}
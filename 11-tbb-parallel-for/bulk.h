@@ -0,0 +1,53 @@
+#ifndef BULK_H
+#define BULK_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Parallel memset, memcpy and iota over large buffers.
+ *
+ * Below a few hundred KB, waking the workers costs more than the work, so
+ * the serial libc functions are used. Up to the last level cache, regular
+ * stores are split across threads and the data stays in cache for the
+ * next consumer. Beyond that, the buffer would evict the cache anyway:
+ * non-temporal stores bypass it, and avoid reading each destination line
+ * before writing it (read for ownership), which saves a third of the
+ * memory traffic of a copy.
+ */
+enum BulkStrategy {
+    BULK_AUTO,
+    BULK_SERIAL,    // single threaded libc
+    BULK_STORE,     // parallel, regular stores
+    BULK_STREAM,    // parallel, non-temporal stores
+};
+
+enum BulkPartitioner {
+    BULK_SIMPLE,    // chunks of at most grain bytes
+    BULK_AUTOPART,  // tbb::auto_partitioner, grain is a minimum
+    BULK_AFFINITY,  // tbb::affinity_partitioner, replays the previous mapping
+};
+
+struct BulkConfig {
+    BulkStrategy strategy;
+    BulkPartitioner partitioner;
+    size_t grain;   // bytes
+
+    BulkConfig(BulkStrategy s = BULK_AUTO, BulkPartitioner p = BULK_AUTOPART,
+               size_t g = 64 * 1024) :
+        strategy(s), partitioner(p), grain(g) { }
+};
+
+// size of the last level cache, from sysconf or sysfs, 8MB if unknown
+size_t bulk_llc_size();
+// strategy of BULK_AUTO for a buffer of this size
+BulkStrategy bulk_choose(size_t bytes);
+const char *bulk_strategy_name(BulkStrategy strategy);
+const char *bulk_partitioner_name(BulkPartitioner partitioner);
+
+void bulk_fill(void *dst, uint8_t value, size_t bytes, const BulkConfig &config = BulkConfig());
+void bulk_copy(void *dst, const void *src, size_t bytes, const BulkConfig &config = BulkConfig());
+// dst[i] = start + i
+void bulk_iota(int *dst, size_t n, int start, const BulkConfig &config = BulkConfig());
+
+#endif // BULK_H
@@ -1,7 +1,14 @@
 #include <QDebug>
 #include <QElapsedTimer>
 #include <QVector>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
 #include "tbb/tbb.h"
+#include "bulk.h"
+#include "tuned_loop.h"
+
+using namespace std;
 
 /*
  * parallel implementation of memset()
@@ -40,7 +47,67 @@ void print_result(QString name, double reference, double actual)
                 .arg(reference / actual, 0, 'f', 2);
 }
 
-int main()
+// best of a few runs, the first one also faults the pages in
+double best(std::function<void ()> func)
+{
+    double t = elapsed(func);
+    for (int i = 0; i < 3; i++) {
+        t = std::min(t, elapsed(func));
+    }
+    return t;
+}
+
+/*
+ * Bandwidth of fill, copy and iota for each strategy, partitioner and
+ * grain, from a buffer that fits in L2 up to max_bytes. A copy moves twice
+ * the bytes. The auto rows show the strategy that bulk_choose() picks.
+ */
+void sweep(size_t max_bytes)
+{
+    // QVector is indexed by int, too small for multi-GB buffers
+    vector<char> src(max_bytes, 1);
+    vector<char> dst(max_bytes, 0);
+
+    QVector<BulkConfig> configs;
+    configs.append(BulkConfig(BULK_AUTO));
+    configs.append(BulkConfig(BULK_SERIAL));
+    for (BulkStrategy strategy : { BULK_STORE, BULK_STREAM }) {
+        for (BulkPartitioner partitioner : { BULK_SIMPLE, BULK_AUTOPART, BULK_AFFINITY }) {
+            for (size_t grain : { 16 << 10, 64 << 10, 256 << 10, 1 << 20 }) {
+                configs.append(BulkConfig(strategy, partitioner, grain));
+            }
+        }
+    }
+
+    qDebug() << "last level cache" << bulk_llc_size() / 1024 << "KB";
+    cout << "op,bytes,strategy,partitioner,grain,seconds,GB/s" << endl;
+    for (size_t bytes = 256 << 10; bytes <= max_bytes; bytes *= 4) {
+        for (const BulkConfig &config : configs) {
+            const char *ops[] = { "fill", "copy", "iota" };
+            for (int op = 0; op < 3; op++) {
+                double t = best([&]() {
+                    if (op == 0)
+                        bulk_fill(dst.data(), op, bytes, config);
+                    else if (op == 1)
+                        bulk_copy(dst.data(), src.data(), bytes, config);
+                    else
+                        bulk_iota((int *) dst.data(), bytes / sizeof(int), 0, config);
+                });
+                BulkStrategy used = config.strategy;
+                if (used == BULK_AUTO)
+                    used = bulk_choose(op == 1 ? 2 * bytes : bytes);
+                double moved = op == 1 ? 2.0 * bytes : bytes;
+                cout << ops[op] << "," << bytes << ","
+                     << (config.strategy == BULK_AUTO ? "auto:" : "")
+                     << bulk_strategy_name(used) << ","
+                     << (used == BULK_SERIAL ? "-" : bulk_partitioner_name(config.partitioner)) << ","
+                     << config.grain << "," << t << "," << moved / t / 1e9 << endl;
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
 {
     int n = 1E6;
     QVector<int> array(n); // elements are initialized
@@ -68,8 +135,29 @@ int main()
     // classic
     tbb::parallel_for(tbb::blocked_range<int>(0, n), MemSet(array.data()));
 
+    // grain size and partitioner tuned online, the first calls try the candidates
+    static TunedLoop iota("11-iota");
+    auto iota_body = [&] (const tbb::blocked_range<int>& range) {
+        for (int i = range.begin(); i < range.end(); i++) {
+            array[i] = i;
+        }
+    };
+    TuneChoice choice;
+    while (!iota.tuned(n, choice)) {
+        iota.parallel_for(0, n, iota_body);
+    }
+    double tuned = elapsed([&]() {
+        iota.parallel_for(0, n, iota_body);
+    });
+
     print_result("serial", serial, serial);
     print_result("parallel", serial, parallel);
+    print_result(QString("tuned %1").arg(QString::fromStdString(choice.toString())), serial, tuned);
+
+    // 1E6 ints fit in the last level cache, sweep up to buffers that do not.
+    // The sweep takes minutes, it runs when the maximum size (MB) is given
+    if (argc > 1)
+        sweep((size_t) atol(argv[1]) << 20);
 
     return 0;
 }
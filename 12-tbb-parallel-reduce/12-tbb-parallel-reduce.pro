@@ -17,4 +17,9 @@ TEMPLATE = app
 LIBS += -ltbb
 
 
-SOURCES += main.cpp
+SOURCES += main.cpp \
+    contention.cpp \
+    reduce.cpp
+
+HEADERS += reduce.h \
+    contention.h
@@ -0,0 +1,219 @@
+#include "contention.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <tbb/tbb.h>
+
+using namespace std;
+
+static const char *VARIANTS[] = { "atomic", "slots", "padded", "combinable", "ets", "register" };
+
+/*
+ * Counters of the calling thread and of the threads it creates while they
+ * are enabled (inherit), user space only so that it works with the
+ * default perf_event_paranoid.
+ */
+class PerfCounters {
+public:
+    PerfCounters()
+    {
+        add(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        add(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        add(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        add(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        const char *raw = getenv("PMU_RAW");
+        if (raw)
+            add(PERF_TYPE_RAW, strtoull(raw, nullptr, 16));
+    }
+
+    ~PerfCounters()
+    {
+        for (int fd : m_fds) {
+            if (fd >= 0)
+                close(fd);
+        }
+    }
+
+    void start()
+    {
+        for (int fd : m_fds) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+
+    // the counts of the threads are added to the parent when they exit
+    vector<int64_t> stop()
+    {
+        vector<int64_t> values;
+        for (int fd : m_fds) {
+            int64_t value = -1;
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+                if (read(fd, &value, sizeof(value)) != sizeof(value))
+                    value = -1;
+            }
+            values.push_back(value);
+        }
+        return values;
+    }
+
+private:
+    void add(uint32_t type, uint64_t config)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fds.push_back(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    vector<int> m_fds;
+};
+
+vector<string> contention_counter_names()
+{
+    vector<string> names = { "cycles", "instructions", "l1d_miss", "llc_miss" };
+    if (getenv("PMU_RAW"))
+        names.push_back(string("raw_") + getenv("PMU_RAW"));
+    return names;
+}
+
+// update(t, data, count) of each share, one std::thread per share
+template<typename Update>
+static void run_threads(int threads, const int32_t *data, size_t n, const Update &update)
+{
+    vector<thread> pool;
+    for (int t = 0; t < threads; t++) {
+        size_t begin = n * t / threads;
+        size_t end = n * (t + 1) / threads;
+        pool.push_back(thread([&, t, begin, end]() {
+            update(t, data + begin, end - begin);
+        }));
+    }
+    for (thread &th : pool) {
+        th.join();
+    }
+}
+
+// 128 bytes apart, so that neither the line nor its adjacent-line prefetch pair is shared
+struct PaddedSlot {
+    int64_t value;
+    char pad[120];
+};
+
+ContentionResult contention_run(const string &variant, const int32_t *data, size_t n, int threads)
+{
+    ContentionResult result;
+    result.variant = variant;
+    result.threads = threads;
+    result.sum = 0;
+
+    vector<int64_t> slots(threads, 0);
+    vector<PaddedSlot> padded(threads);
+    atomic<int64_t> shared(0);
+    tbb::combinable<int64_t> combinable([]() { return int64_t(0); });
+    tbb::enumerable_thread_specific<int64_t> ets(0);
+    for (PaddedSlot &slot : padded) {
+        slot.value = 0;
+    }
+
+    PerfCounters counters;
+    auto t0 = chrono::steady_clock::now();
+    counters.start();
+    if (variant == "atomic") {
+        run_threads(threads, data, n, [&](int, const int32_t *p, size_t len) {
+            for (size_t i = 0; i < len; i++) {
+                shared.fetch_add(p[i], memory_order_relaxed);
+            }
+        });
+        result.sum = shared.load();
+    } else if (variant == "slots" || variant == "padded") {
+        bool pad = variant == "padded";
+        run_threads(threads, data, n, [&](int t, const int32_t *p, size_t len) {
+            volatile int64_t &slot = pad ? padded[t].value : slots[t];
+            for (size_t i = 0; i < len; i++) {
+                slot += p[i];
+            }
+        });
+        for (int t = 0; t < threads; t++) {
+            result.sum += pad ? padded[t].value : slots[t];
+        }
+    } else if (variant == "combinable") {
+        run_threads(threads, data, n, [&](int, const int32_t *p, size_t len) {
+            volatile int64_t &local = combinable.local();
+            for (size_t i = 0; i < len; i++) {
+                local += p[i];
+            }
+        });
+        result.sum = combinable.combine(plus<int64_t>());
+    } else if (variant == "ets") {
+        run_threads(threads, data, n, [&](int, const int32_t *p, size_t len) {
+            volatile int64_t &local = ets.local();
+            for (size_t i = 0; i < len; i++) {
+                local += p[i];
+            }
+        });
+        for (int64_t value : ets) {
+            result.sum += value;
+        }
+    } else {
+        run_threads(threads, data, n, [&](int t, const int32_t *p, size_t len) {
+            int64_t local = 0;
+            for (size_t i = 0; i < len; i++) {
+                local += p[i];
+            }
+            slots[t] = local;
+        });
+        for (int t = 0; t < threads; t++) {
+            result.sum += slots[t];
+        }
+    }
+    result.counters = counters.stop();
+    chrono::duration<double> t = chrono::steady_clock::now() - t0;
+    result.seconds = t.count();
+    return result;
+}
+
+void contention_benchmark(const int32_t *data, size_t n, int max_threads)
+{
+    vector<int> counts;
+    for (int threads = 1; threads < max_threads; threads *= 2) {
+        counts.push_back(threads);
+    }
+    counts.push_back(max(max_threads, 1));
+
+    cout << "variant,threads,seconds,Mupdates/s,sum";
+    for (const string &name : contention_counter_names()) {
+        cout << "," << name;
+    }
+    cout << endl;
+    for (const char *variant : VARIANTS) {
+        for (int threads : counts) {
+            ContentionResult r = contention_run(variant, data, n, threads);
+            cout << r.variant << "," << r.threads << "," << r.seconds << ","
+                 << n / r.seconds / 1e6 << "," << r.sum;
+            for (int64_t value : r.counters) {
+                cout << "," << value;
+            }
+            cout << endl;
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef CONTENTION_H
+#define CONTENTION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Cost of the per-thread accumulators of a reduction. Each thread adds its
+ * share of the data to an accumulator, one update per element, with:
+ *
+ * - atomic: a single shared std::atomic, every update bounces its line
+ * - slots: one slot per thread in a plain array, the slots share lines
+ *   (false sharing)
+ * - padded: one slot per thread, each on its own cache line
+ * - combinable: tbb::combinable, local() looked up once per thread
+ * - ets: tbb::enumerable_thread_specific, same
+ * - register: a local variable, published once at the end
+ *
+ * The updates of the memory variants go through a volatile reference, so
+ * that the compiler does not keep the accumulator in a register.
+ *
+ * The threads are std::threads started inside the measurement, so that
+ * the inherited perf counters see them. The counters are cycles,
+ * instructions, L1D read misses and LLC misses, plus the raw event given
+ * by PMU_RAW (hex, for instance the HITM event of the machine) if set.
+ */
+struct ContentionResult {
+    std::string variant;
+    int threads;
+    double seconds;
+    int64_t sum;
+    // -1 when the counter is not available
+    std::vector<int64_t> counters;
+};
+
+std::vector<std::string> contention_counter_names();
+
+ContentionResult contention_run(const std::string &variant, const int32_t *data, size_t n,
+                                int threads);
+
+// every variant for 1 to max_threads threads, as CSV on stdout
+void contention_benchmark(const int32_t *data, size_t n, int max_threads);
+
+#endif // CONTENTION_H
@@ -1,8 +1,11 @@
 #include <QDebug>
 #include <QElapsedTimer>
 #include <QMutex>
+#include <cstring>
 #include <thread>
 #include "tbb/tbb.h"
+#include "contention.h"
+#include "reduce.h"
 
 using namespace std;
 
@@ -10,7 +13,7 @@ struct work {
     int n;
     int rank;
     QVector<int> *data;
-    int local_sum;
+    qint64 local_sum;
 };
 
 /*
@@ -41,11 +44,12 @@ public:
     void join(Sum& right) {
         m_value += right.m_value;
     }
-    int m_value;
+    // the sum of 1E7 ints does not fit in an int
+    qint64 m_value;
     int *m_data;
 };
 
-int fast_sum(QVector<int> &data)
+qint64 fast_sum(QVector<int> &data)
 {
     Sum sum(data.data());
     tbb::parallel_reduce(tbb::blocked_range<int>(0, data.length()), sum);
@@ -57,18 +61,18 @@ void do_sum(work *arg)
     int begin = arg->data->size() * arg->rank / arg->n;
     int end = arg->data->size() * (arg->rank + 1) / arg->n;
     int *v = arg->data->data();
-    int sum = 0;
+    qint64 sum = 0;
     for (int i = begin; i < end; i++) {
         sum += v[i];
     }
     arg->local_sum = sum;
 }
 
-int reduce_pthread(QVector<int> &v, int n)
+qint64 reduce_pthread(QVector<int> &v, int n)
 {
     thread threads[n];
     work items[n];
-    int final_sum = 0;
+    qint64 final_sum = 0;
 
     for (int i = 0; i < n; i++) {
         items[i] = work{n, i, &v, 0};
@@ -109,7 +113,7 @@ int main()
     }
 
     // serial
-    int exp = 0;
+    qint64 exp = 0;
     double elapsed_serial = elapsed([&]() {
         for (int i = 0; i < n; i++) {
             exp += v[i];
@@ -117,7 +121,7 @@ int main()
     });
 
     // reduction with parallel_for
-    int sum0 = 0;
+    qint64 sum0 = 0;
     double elapsed_race = elapsed([&]() {
         tbb::parallel_for(0, v.size(), [&](int &i) {
             sum0 += v[i]; // race condition!
@@ -140,7 +144,7 @@ int main()
     qDebug() << "exp" << exp << "act" << sum0;
 
     // reduction without lock
-    int sum1 = 0;
+    qint64 sum1 = 0;
     int cpus = thread::hardware_concurrency();
     double elapsed_pthread = elapsed([&]() {
         sum1 = reduce_pthread(v, cpus);
@@ -148,12 +152,12 @@ int main()
     qDebug() << "exp" << exp << "act" << sum1;
 
     // lambda
-    int sum2 = tbb::parallel_reduce(
+    qint64 sum2 = tbb::parallel_reduce(
         tbb::blocked_range<int>(0, n),  // global range to process
-        0,                              // initial value
+        qint64(0),                      // initial value
 
         // first lambda: compute the reduce for a subrange
-        [&] (const tbb::blocked_range<int>& range, int sum) -> int {
+        [&] (const tbb::blocked_range<int>& range, qint64 sum) -> qint64 {
             for (int i = range.begin(); i < range.end(); i++) {
                 sum += v[i];
             }
@@ -161,7 +165,7 @@ int main()
         },
 
         // second lambda: merge range results
-        [] (int x, int y) -> int {
+        [] (qint64 x, qint64 y) -> qint64 {
             return x + y;
         }
     );
@@ -169,7 +173,7 @@ int main()
     qDebug() << "exp" << exp << "act" << sum2;
 
     // classic parallel_reduce
-    int sum3 = 0;
+    qint64 sum3 = 0;
     double elapsed_tbb = elapsed([&]() {
         sum3 = fast_sum(v);
     });
@@ -181,5 +185,93 @@ int main()
     print_result("pthread", elapsed_serial, elapsed_pthread);
     print_result("tbb", elapsed_serial, elapsed_tbb);
 
+    // generic reductions, vectorized kernels
+    const int32_t *data = v.constData();
+    qint64 sum4 = 0, sum5 = 0, sum6 = 0;
+    double elapsed_kernel = elapsed([&]() {
+        sum4 = reduce_kernel(data, n, SumOp<int32_t>());
+    });
+    double elapsed_simd_tbb = elapsed([&]() {
+        sum5 = reduce_tbb(data, n, SumOp<int32_t>());
+    });
+    double elapsed_simd_threads = elapsed([&]() {
+        sum6 = reduce_threads(data, n, SumOp<int32_t>(), cpus);
+    });
+    qDebug() << "exp" << exp << "act" << sum4 << sum5 << sum6;
+
+    print_result("simd", elapsed_serial, elapsed_kernel);
+    print_result("simd tbb", elapsed_serial, elapsed_simd_tbb);
+    print_result("simd thread", elapsed_serial, elapsed_simd_threads);
+
+    // the other monoids
+    MinMax<int32_t> range = reduce_tbb(data, n, MinMaxOp<int32_t>());
+    qDebug() << "min" << reduce_tbb(data, n, MinOp<int32_t>())
+             << "max" << reduce_threads(data, n, MaxOp<int32_t>(), cpus)
+             << "min-max" << range.min << range.max
+             << "multiples of 7" << reduce_tbb(data, n, count_if_op<int32_t>([](int32_t x) {
+                    return x % 7 == 0;
+                }));
+
+    QVector<float> f(n);
+    for (int i = 0; i < n; i++) {
+        f[i] = 1.0f / (i + 1);
+    }
+    float sum_float = 0;
+    double elapsed_float = elapsed([&]() {
+        for (int i = 0; i < n; i++) {
+            sum_float += f[i];
+        }
+    });
+    double sum_double = 0;
+    double elapsed_double_tbb = elapsed([&]() {
+        sum_double = reduce_tbb(f.constData(), n, SumOp<float>());
+    });
+    qDebug() << "harmonic float" << sum_float << "double" << sum_double;
+    print_result("float", elapsed_float, elapsed_float);
+    print_result("simd tbb", elapsed_float, elapsed_double_tbb);
+
+    // the float sum of parallel_reduce changes with the thread count, the
+    // deterministic one does not: it is compared bitwise to the one thread
+    // result. The scheduler is already initialised by the loops above, each
+    // thread count runs in its own arena.
+    float det_reference = 0;
+    Kahan<double> kahan_reference;
+    for (int threads = 1; threads <= cpus; threads *= 2) {
+        tbb::task_arena arena(threads);
+        float sum_tbb = 0, sum_det = 0;
+        Kahan<double> sum_kahan;
+        double elapsed_tbb_float = 0, elapsed_det = 0, elapsed_kahan = 0;
+        arena.execute([&]() {
+            elapsed_tbb_float = elapsed([&]() {
+                sum_tbb = reduce_tbb(f.constData(), n, SumOp<float, float>());
+            });
+            elapsed_det = elapsed([&]() {
+                sum_det = reduce_deterministic(f.constData(), n, SumOp<float, float>());
+            });
+            elapsed_kahan = elapsed([&]() {
+                sum_kahan = reduce_deterministic(f.constData(), n, KahanSumOp<float>());
+            });
+        });
+        if (threads == 1) {
+            det_reference = sum_det;
+            kahan_reference = sum_kahan;
+        }
+        qDebug() << "threads" << threads
+                 << QString("tbb %1 deterministic %2 kahan %3")
+                    .arg(sum_tbb, 0, 'g', 9)
+                    .arg(sum_det, 0, 'g', 9)
+                    .arg(sum_kahan.value(), 0, 'g', 17);
+        if (memcmp(&sum_det, &det_reference, sizeof(sum_det)) != 0)
+            qDebug() << "MISMATCH deterministic sum differs from 1 thread";
+        if (memcmp(&sum_kahan, &kahan_reference, sizeof(sum_kahan)) != 0)
+            qDebug() << "MISMATCH kahan sum differs from 1 thread";
+        print_result("tbb float", elapsed_tbb_float, elapsed_tbb_float);
+        print_result("determin.", elapsed_tbb_float, elapsed_det);
+        print_result("kahan", elapsed_tbb_float, elapsed_kahan);
+    }
+
+    // per-thread accumulators under contention, with the PMU counters
+    contention_benchmark(data, n, cpus);
+
     return 0;
 }
@@ -0,0 +1,141 @@
+#include "reduce.h"
+
+#include <immintrin.h>
+
+static bool has_avx2()
+{
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+
+/*
+ * Four vector accumulators, 16 elements per iteration. The int32 elements
+ * are widened to int64 before the addition.
+ */
+__attribute__((target("avx2")))
+static int64_t sum_i32_avx2(const int32_t *p, size_t n)
+{
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    __m256i acc2 = _mm256_setzero_si256();
+    __m256i acc3 = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_add_epi64(acc0, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *) (p + i))));
+        acc1 = _mm256_add_epi64(acc1, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *) (p + i + 4))));
+        acc2 = _mm256_add_epi64(acc2, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *) (p + i + 8))));
+        acc3 = _mm256_add_epi64(acc3, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *) (p + i + 12))));
+    }
+    __m256i acc = _mm256_add_epi64(_mm256_add_epi64(acc0, acc1), _mm256_add_epi64(acc2, acc3));
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *) lanes, acc);
+    int64_t sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < n; i++) {
+        sum += p[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx2")))
+static MinMax<int32_t> minmax_i32_avx2(const int32_t *p, size_t n, bool want_min, bool want_max)
+{
+    MinMaxOp<int32_t> op;
+    MinMax<int32_t> result = op.identity();
+    __m256i min0 = _mm256_set1_epi32(result.min);
+    __m256i min1 = min0;
+    __m256i max0 = _mm256_set1_epi32(result.max);
+    __m256i max1 = max0;
+    size_t i = 0;
+    if (want_min && want_max) {
+        for (; i + 16 <= n; i += 16) {
+            __m256i a = _mm256_loadu_si256((const __m256i *) (p + i));
+            __m256i b = _mm256_loadu_si256((const __m256i *) (p + i + 8));
+            min0 = _mm256_min_epi32(min0, a);
+            min1 = _mm256_min_epi32(min1, b);
+            max0 = _mm256_max_epi32(max0, a);
+            max1 = _mm256_max_epi32(max1, b);
+        }
+    } else if (want_min) {
+        for (; i + 16 <= n; i += 16) {
+            min0 = _mm256_min_epi32(min0, _mm256_loadu_si256((const __m256i *) (p + i)));
+            min1 = _mm256_min_epi32(min1, _mm256_loadu_si256((const __m256i *) (p + i + 8)));
+        }
+    } else {
+        for (; i + 16 <= n; i += 16) {
+            max0 = _mm256_max_epi32(max0, _mm256_loadu_si256((const __m256i *) (p + i)));
+            max1 = _mm256_max_epi32(max1, _mm256_loadu_si256((const __m256i *) (p + i + 8)));
+        }
+    }
+    int32_t lanes[8];
+    _mm256_storeu_si256((__m256i *) lanes, _mm256_min_epi32(min0, min1));
+    for (int k = 0; k < 8; k++) {
+        result.min = std::min(result.min, lanes[k]);
+    }
+    _mm256_storeu_si256((__m256i *) lanes, _mm256_max_epi32(max0, max1));
+    for (int k = 0; k < 8; k++) {
+        result.max = std::max(result.max, lanes[k]);
+    }
+    for (; i < n; i++) {
+        result = op.step(result, p[i]);
+    }
+    return result;
+}
+
+__attribute__((target("avx2")))
+static double sum_f32_avx2(const float *p, size_t n)
+{
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    __m256d acc2 = _mm256_setzero_pd();
+    __m256d acc3 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_add_pd(acc0, _mm256_cvtps_pd(_mm_loadu_ps(p + i)));
+        acc1 = _mm256_add_pd(acc1, _mm256_cvtps_pd(_mm_loadu_ps(p + i + 4)));
+        acc2 = _mm256_add_pd(acc2, _mm256_cvtps_pd(_mm_loadu_ps(p + i + 8)));
+        acc3 = _mm256_add_pd(acc3, _mm256_cvtps_pd(_mm_loadu_ps(p + i + 12)));
+    }
+    __m256d acc = _mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3));
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; i++) {
+        sum += p[i];
+    }
+    return sum;
+}
+
+int64_t reduce_kernel(const int32_t *p, size_t n, const SumOp<int32_t, int64_t> &op)
+{
+    if (has_avx2())
+        return sum_i32_avx2(p, n);
+    return reduce_lanes(p, n, op);
+}
+
+int32_t reduce_kernel(const int32_t *p, size_t n, const MinOp<int32_t> &op)
+{
+    if (has_avx2())
+        return minmax_i32_avx2(p, n, true, false).min;
+    return reduce_lanes(p, n, op);
+}
+
+int32_t reduce_kernel(const int32_t *p, size_t n, const MaxOp<int32_t> &op)
+{
+    if (has_avx2())
+        return minmax_i32_avx2(p, n, false, true).max;
+    return reduce_lanes(p, n, op);
+}
+
+MinMax<int32_t> reduce_kernel(const int32_t *p, size_t n, const MinMaxOp<int32_t> &op)
+{
+    if (has_avx2())
+        return minmax_i32_avx2(p, n, true, true);
+    return reduce_lanes(p, n, op);
+}
+
+double reduce_kernel(const float *p, size_t n, const SumOp<float, double> &op)
+{
+    if (has_avx2())
+        return sum_f32_avx2(p, n);
+    return reduce_lanes(p, n, op);
+}
@@ -0,0 +1,244 @@
+#ifndef REDUCE_H
+#define REDUCE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <vector>
+#include <tbb/tbb.h>
+
+/*
+ * Generic reductions over arrays of any length, parameterised by the
+ * element type and a monoid: the accumulator type, its identity, how to
+ * fold an element in (step) and how to merge two partial results
+ * (combine).
+ *
+ * The sum accumulates in a wider type by default, int32 into int64 and
+ * float into double, so that the sum of a large array does not overflow.
+ *
+ * The serial kernel keeps several independent accumulators: with a single
+ * one, each addition waits for the previous one, and the loop runs at the
+ * latency of the add instead of its throughput. The common cases (sum, min,
+ * max and min-max of int32, sum of float) have AVX2 kernels, used when the
+ * CPU supports it.
+ */
+
+template<typename T> struct wide { typedef T type; };
+template<> struct wide<int8_t> { typedef int64_t type; };
+template<> struct wide<int16_t> { typedef int64_t type; };
+template<> struct wide<int32_t> { typedef int64_t type; };
+template<> struct wide<uint8_t> { typedef uint64_t type; };
+template<> struct wide<uint16_t> { typedef uint64_t type; };
+template<> struct wide<uint32_t> { typedef uint64_t type; };
+template<> struct wide<float> { typedef double type; };
+
+template<typename T, typename Acc = typename wide<T>::type>
+struct SumOp {
+    typedef Acc value_type;
+    Acc identity() const { return Acc(0); }
+    Acc step(Acc acc, T x) const { return acc + Acc(x); }
+    Acc combine(Acc a, Acc b) const { return a + b; }
+};
+
+template<typename T>
+struct MinOp {
+    typedef T value_type;
+    T identity() const { return std::numeric_limits<T>::has_infinity ?
+                std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max(); }
+    T step(T acc, T x) const { return std::min(acc, x); }
+    T combine(T a, T b) const { return std::min(a, b); }
+};
+
+template<typename T>
+struct MaxOp {
+    typedef T value_type;
+    T identity() const { return std::numeric_limits<T>::has_infinity ?
+                -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest(); }
+    T step(T acc, T x) const { return std::max(acc, x); }
+    T combine(T a, T b) const { return std::max(a, b); }
+};
+
+template<typename T>
+struct MinMax {
+    T min;
+    T max;
+};
+
+template<typename T>
+struct MinMaxOp {
+    typedef MinMax<T> value_type;
+    MinMax<T> identity() const { return MinMax<T>{ MinOp<T>().identity(), MaxOp<T>().identity() }; }
+    MinMax<T> step(MinMax<T> acc, T x) const
+    {
+        return MinMax<T>{ std::min(acc.min, x), std::max(acc.max, x) };
+    }
+    MinMax<T> combine(MinMax<T> a, MinMax<T> b) const
+    {
+        return MinMax<T>{ std::min(a.min, b.min), std::max(a.max, b.max) };
+    }
+};
+
+/*
+ * Compensated sum: each step keeps the rounding error of the addition and
+ * feeds it back into the next one (Kahan-Babuska-Neumaier), so the error
+ * does not grow with the number of elements. It must not be compiled with
+ * -ffast-math, which would simplify the compensation away.
+ */
+template<typename T>
+struct Kahan {
+    T sum;
+    T c;
+    T value() const { return sum + c; }
+};
+
+template<typename T, typename Acc = typename wide<T>::type>
+struct KahanSumOp {
+    typedef Kahan<Acc> value_type;
+    Kahan<Acc> identity() const { return Kahan<Acc>{ Acc(0), Acc(0) }; }
+    Kahan<Acc> step(Kahan<Acc> acc, T x) const { return add(acc, Acc(x)); }
+    Kahan<Acc> combine(Kahan<Acc> a, Kahan<Acc> b) const
+    {
+        a = add(a, b.sum);
+        a.c += b.c;
+        return a;
+    }
+    static Kahan<Acc> add(Kahan<Acc> acc, Acc y)
+    {
+        Acc t = acc.sum + y;
+        if (std::abs(acc.sum) >= std::abs(y))
+            acc.c += (acc.sum - t) + y;
+        else
+            acc.c += (y - t) + acc.sum;
+        acc.sum = t;
+        return acc;
+    }
+};
+
+template<typename T, typename Pred>
+struct CountIfOp {
+    typedef uint64_t value_type;
+    Pred pred;
+    explicit CountIfOp(Pred p) : pred(p) { }
+    uint64_t identity() const { return 0; }
+    uint64_t step(uint64_t acc, T x) const { return acc + (pred(x) ? 1 : 0); }
+    uint64_t combine(uint64_t a, uint64_t b) const { return a + b; }
+};
+
+template<typename T, typename Pred>
+CountIfOp<T, Pred> count_if_op(Pred pred)
+{
+    return CountIfOp<T, Pred>(pred);
+}
+
+// independent accumulators of the generic kernel
+static const int REDUCE_LANES = 8;
+
+template<typename T, typename Op>
+typename Op::value_type reduce_lanes(const T *p, size_t n, const Op &op)
+{
+    typedef typename Op::value_type Acc;
+    Acc acc[REDUCE_LANES];
+    std::fill(acc, acc + REDUCE_LANES, op.identity());
+    size_t i = 0;
+    for (; i + REDUCE_LANES <= n; i += REDUCE_LANES) {
+        for (int k = 0; k < REDUCE_LANES; k++) {
+            acc[k] = op.step(acc[k], p[i + k]);
+        }
+    }
+    for (; i < n; i++) {
+        acc[0] = op.step(acc[0], p[i]);
+    }
+    for (int k = 1; k < REDUCE_LANES; k++) {
+        acc[0] = op.combine(acc[0], acc[k]);
+    }
+    return acc[0];
+}
+
+// serial kernel, the overloads below take the AVX2 path when available
+template<typename T, typename Op>
+typename Op::value_type reduce_kernel(const T *p, size_t n, const Op &op)
+{
+    return reduce_lanes(p, n, op);
+}
+
+int64_t reduce_kernel(const int32_t *p, size_t n, const SumOp<int32_t, int64_t> &op);
+int32_t reduce_kernel(const int32_t *p, size_t n, const MinOp<int32_t> &op);
+int32_t reduce_kernel(const int32_t *p, size_t n, const MaxOp<int32_t> &op);
+MinMax<int32_t> reduce_kernel(const int32_t *p, size_t n, const MinMaxOp<int32_t> &op);
+double reduce_kernel(const float *p, size_t n, const SumOp<float, double> &op);
+
+template<typename T, typename Op>
+typename Op::value_type reduce_tbb(const T *p, size_t n, const Op &op, size_t grain = 1 << 16)
+{
+    typedef typename Op::value_type Acc;
+    return tbb::parallel_reduce(tbb::blocked_range<size_t>(0, n, grain), op.identity(),
+        [&](const tbb::blocked_range<size_t> &range, Acc acc) -> Acc {
+            return op.combine(acc, reduce_kernel(p + range.begin(), range.size(), op));
+        },
+        [&](Acc a, Acc b) -> Acc {
+            return op.combine(a, b);
+        });
+}
+
+// one contiguous block per thread, each thread writes its result once
+template<typename T, typename Op>
+typename Op::value_type reduce_threads(const T *p, size_t n, const Op &op,
+                                       int nthreads = std::thread::hardware_concurrency())
+{
+    typedef typename Op::value_type Acc;
+    nthreads = std::max(nthreads, 1);
+    std::vector<Acc> partial(nthreads, op.identity());
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; t++) {
+        size_t begin = n * t / nthreads;
+        size_t end = n * (t + 1) / nthreads;
+        threads.push_back(std::thread([&, t, begin, end]() {
+            partial[t] = reduce_kernel(p + begin, end - begin, op);
+        }));
+    }
+    Acc acc = op.identity();
+    for (int t = 0; t < nthreads; t++) {
+        threads[t].join();
+        acc = op.combine(acc, partial[t]);
+    }
+    return acc;
+}
+
+/*
+ * Reproducible reduction. parallel_reduce splits the range depending on
+ * the number of threads and on which thread steals what, and floating
+ * point addition is not associative, so the last bits of a sum change from
+ * one run to the next. Here the blocking is fixed, block elements whatever
+ * the thread count, each block is reduced by the same serial kernel, and
+ * the block results are combined by a fixed pairwise tree. The threads
+ * only decide who computes which block: the result is bit-identical for
+ * any number of threads on a given machine. The kernel may differ between
+ * machines, with or without AVX2.
+ */
+template<typename T, typename Op>
+typename Op::value_type reduce_deterministic(const T *p, size_t n, const Op &op,
+                                             size_t block = 1 << 14)
+{
+    typedef typename Op::value_type Acc;
+    if (n == 0)
+        return op.identity();
+    size_t nblocks = (n + block - 1) / block;
+    std::vector<Acc> partial(nblocks);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, nblocks), [&](const tbb::blocked_range<size_t> &range) {
+        for (size_t b = range.begin(); b < range.end(); b++) {
+            size_t begin = b * block;
+            partial[b] = reduce_kernel(p + begin, std::min(block, n - begin), op);
+        }
+    });
+    for (size_t stride = 1; stride < nblocks; stride *= 2) {
+        for (size_t i = 0; i + stride < nblocks; i += 2 * stride) {
+            partial[i] = op.combine(partial[i], partial[i + stride]);
+        }
+    }
+    return partial[0];
+}
+
+#endif // REDUCE_H
@@ -17,4 +17,9 @@ TEMPLATE = app
 LIBS += -ltbb
 
 
-SOURCES += main.cpp
+SOURCES += main.cpp \
+    distribution.cpp
+
+HEADERS += distribution.h \
+    radix_sort.h \
+    record_sort.h
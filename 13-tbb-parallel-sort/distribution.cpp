@@ -0,0 +1,116 @@
+#include "distribution.h"
+
+#include <algorithm>
+#include <random>
+#include <tbb/tbb.h>
+
+static const char *NAMES[] = { "uniform", "sorted", "reverse", "nearly-sorted",
+                               "few-unique", "zipf", "all-equal" };
+
+// elements generated from the same seed
+static const size_t GENERATE_BLOCK = 1 << 20;
+static const size_t ZIPF_RANKS = 1 << 20;
+static const int FEW_UNIQUE_VALUES = 16;
+static const int NEARLY_SORTED_DISTANCE = 64;
+
+const char *distribution_name(Distribution d)
+{
+    return NAMES[d];
+}
+
+bool distribution_parse(const std::string &name, Distribution &d)
+{
+    for (int i = 0; i < DISTRIBUTION_COUNT; i++) {
+        if (name == NAMES[i]) {
+            d = (Distribution) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<Distribution> distribution_all()
+{
+    std::vector<Distribution> all;
+    for (int i = 0; i < DISTRIBUTION_COUNT; i++) {
+        all.push_back((Distribution) i);
+    }
+    return all;
+}
+
+// cumulative probabilities of the ranks 1..m, 1/k normalized
+static std::vector<double> zipf_cdf(size_t m)
+{
+    std::vector<double> cdf(m);
+    double sum = 0;
+    for (size_t k = 0; k < m; k++) {
+        sum += 1.0 / (k + 1);
+        cdf[k] = sum;
+    }
+    for (size_t k = 0; k < m; k++) {
+        cdf[k] /= sum;
+    }
+    return cdf;
+}
+
+void distribution_generate(Distribution d, int32_t *data, size_t n, uint64_t seed)
+{
+    std::vector<double> cdf;
+    if (d == ZIPF)
+        cdf = zipf_cdf(std::max<size_t>(1, std::min(n, ZIPF_RANKS)));
+
+    size_t blocks = (n + GENERATE_BLOCK - 1) / GENERATE_BLOCK;
+    tbb::parallel_for(size_t(0), blocks, [&](size_t b) {
+        std::seed_seq seq = { (uint32_t) seed, (uint32_t) (seed >> 32),
+                              (uint32_t) b, (uint32_t) (b >> 32) };
+        std::mt19937_64 rng(seq);
+        size_t begin = b * GENERATE_BLOCK;
+        size_t end = std::min(n, begin + GENERATE_BLOCK);
+
+        switch (d) {
+        case UNIFORM:
+            for (size_t i = begin; i < end; i++) {
+                data[i] = (int32_t) (uint32_t) rng();
+            }
+            break;
+        case SORTED:
+        case NEARLY_SORTED:
+            for (size_t i = begin; i < end; i++) {
+                data[i] = (int32_t) i;
+            }
+            break;
+        case REVERSE:
+            for (size_t i = begin; i < end; i++) {
+                data[i] = (int32_t) (n - 1 - i);
+            }
+            break;
+        case FEW_UNIQUE:
+            for (size_t i = begin; i < end; i++) {
+                data[i] = (int32_t) (rng() % FEW_UNIQUE_VALUES);
+            }
+            break;
+        case ZIPF: {
+            std::uniform_real_distribution<double> uniform(0.0, 1.0);
+            for (size_t i = begin; i < end; i++) {
+                size_t rank = std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+                data[i] = (int32_t) std::min(rank, cdf.size() - 1) + 1;
+            }
+            break;
+        }
+        case ALL_EQUAL:
+        default:
+            std::fill(data + begin, data + end, 42);
+            break;
+        }
+
+        // the swaps stay inside the block, so that the blocks are independent
+        if (d == NEARLY_SORTED && end - begin > 1) {
+            size_t len = end - begin;
+            for (size_t k = 0; k < len / 200; k++) {
+                size_t i = begin + rng() % len;
+                size_t j = std::min(end - 1, i + 1 + rng() % NEARLY_SORTED_DISTANCE);
+                std::swap(data[i], data[j]);
+            }
+        }
+    });
+}
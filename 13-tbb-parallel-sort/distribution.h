@@ -0,0 +1,43 @@
+#ifndef DISTRIBUTION_H
+#define DISTRIBUTION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Inputs of the sort benchmark. The generation is parallel and seeded per
+ * block of the array, so that a (distribution, n, seed) triple gives the
+ * same array whatever the number of threads.
+ *
+ * - uniform: uniform over the whole int32 range
+ * - sorted, reverse: 0..n-1, ascending or descending
+ * - nearly sorted: sorted, then 1% of the elements swapped with a
+ *   neighbour at most 64 places away
+ * - few unique: uniform over 16 values
+ * - zipf: rank k drawn with probability proportional to 1/k, over up to
+ *   2^20 ranks, the value is the rank
+ * - all equal: a single value
+ */
+enum Distribution {
+    UNIFORM,
+    SORTED,
+    REVERSE,
+    NEARLY_SORTED,
+    FEW_UNIQUE,
+    ZIPF,
+    ALL_EQUAL,
+    DISTRIBUTION_COUNT
+};
+
+const char *distribution_name(Distribution d);
+
+// false if the name is unknown
+bool distribution_parse(const std::string &name, Distribution &d);
+
+std::vector<Distribution> distribution_all();
+
+void distribution_generate(Distribution d, int32_t *data, size_t n, uint64_t seed);
+
+#endif // DISTRIBUTION_H
@@ -1,14 +1,26 @@
 #include <algorithm>
+#include <cassert>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <functional>
+#include <iostream>
 
+#include <QCommandLineParser>
+#include <QCoreApplication>
 #include <QVector>
 #include <QDebug>
 #include <QElapsedTimer>
 
 #include <tbb/parallel_for.h>
 #include <tbb/parallel_sort.h>
+#include <tbb/tbb.h>
+
+#include "distribution.h"
+#include "radix_sort.h"
+#include "record_sort.h"
+
+using namespace std;
 
 double elapsed(std::function<void ()> func)
 {
@@ -26,39 +38,220 @@ void  print_result(QString name, double reference, double actual)
                 .arg(reference / actual, 0, 'f', 2);
 }
 
-int main(int argc, char *argv[])
+/*
+ * Records of Size bytes sorted by their 64-bit key, moving the records
+ * (tbb::parallel_sort, radix sort) or moving indices (argsort, then one
+ * gather of the records), stored as an array of records (AoS) or as an
+ * array of keys next to an array of payloads (SoA).
+ */
+template<int Size>
+void benchmark_records(int n)
 {
-    (void) argc;
-    (void) argv;
+    typedef Record<Size> R;
+    QVector<R> records(n);
+    for (int i = 0; i < n; ++i) {
+        records[i].key = (quint64) rand() * rand() * rand();
+        memset(records[i].payload, (char) records[i].key, sizeof(records[i].payload));
+    }
+    auto check = [](const QVector<R> &sorted) {
+        for (int i = 0; i < sorted.size(); ++i) {
+            assert(i == 0 || sorted[i - 1].key <= sorted[i].key);
+            assert(sorted[i].payload[sizeof(sorted[i].payload) - 1] == (char) sorted[i].key);
+        }
+    };
 
-    const int n = 1E6;
+    QVector<R> aos = records;
+    double t = elapsed([&]() {
+        tbb::parallel_sort(aos.begin(), aos.end(), [](const R &a, const R &b) {
+            return a.key < b.key;
+        });
+    });
+    check(aos);
+
+    aos = records;
+    double r = elapsed([&]() { radix_sort(aos.data(), aos.size(), record_key()); });
+    check(aos);
+
+    aos = records;
+    double a = elapsed([&]() { sort_by_index(aos.data(), aos.size(), record_key()); });
+    check(aos);
 
-    QVector<int> ints(n);
+    // SoA: the keys are sorted with their indices, the payloads are gathered once
+    typedef Payload<Size> P;
+    QVector<quint64> keys(n);
+    QVector<P> payloads(n);
+    for (int i = 0; i < n; ++i) {
+        keys[i] = records[i].key;
+        memcpy(payloads[i].bytes, records[i].payload, sizeof(P));
+    }
+    QVector<quint64> sorted_keys(n);
+    QVector<P> sorted_payloads(n);
+    double s = elapsed([&]() {
+        std::vector<uint32_t> perm = argsort(keys.data(), n);
+        apply_permutation(keys.data(), sorted_keys.data(), perm.data(), n);
+        apply_permutation(payloads.data(), sorted_payloads.data(), perm.data(), n);
+    });
+    assert(std::is_sorted(sorted_keys.begin(), sorted_keys.end()));
     for (int i = 0; i < n; ++i) {
-        ints[i] = i;
+        assert(sorted_payloads[i].bytes[sizeof(P) - 1] == (char) sorted_keys[i]);
     }
 
-    QVector<double> serial;
-    QVector<double> parallel;
-    for (int i = 0; i < 10; i++) {
-        std::random_shuffle(ints.begin(), ints.end());
-        double s = elapsed([&]() {
-            std::sort(ints.begin(), ints.end());
+    // (key, value) pairs, the value being the index of the record
+    QVector<std::pair<quint64, quint32>> pairs(n);
+    for (int i = 0; i < n; ++i) {
+        pairs[i] = std::make_pair(records[i].key, (quint32) i);
+    }
+    QVector<std::pair<quint64, quint32>> pairs2 = pairs;
+    double pt = elapsed([&]() { tbb::parallel_sort(pairs.begin(), pairs.end()); });
+    double pr = elapsed([&]() {
+        radix_sort(pairs2.data(), pairs2.size(), [](const std::pair<quint64, quint32> &p) {
+            return p.first;
         });
-        std::random_shuffle(ints.begin(), ints.end());
+    });
+    assert(std::is_sorted(pairs2.begin(), pairs2.end()));
 
-        double p = elapsed([&]() {
-            tbb::parallel_sort(ints.begin(), ints.end());
-        });
-        serial.push_back(s);
-        parallel.push_back(p);
+    QString size = QString::number(Size);
+    print_result(size + "B tbb", t, t);
+    print_result(size + "B radix", t, r);
+    print_result(size + "B argsort", t, a);
+    print_result(size + "B soa", t, s);
+    print_result("pairs tbb", pt, pt);
+    print_result("pairs radix", pt, pr);
+}
+
+static const char *ALGORITHMS[] = { "std::sort", "tbb", "radix lsd", "radix msd" };
+
+// sorts data with the algorithm, returns the time
+double sort_once(int algorithm, std::vector<int32_t> &data)
+{
+    switch (algorithm) {
+    case 0:
+        return elapsed([&]() { std::sort(data.begin(), data.end()); });
+    case 1:
+        return elapsed([&]() { tbb::parallel_sort(data.begin(), data.end()); });
+    case 2:
+        return elapsed([&]() { radix_sort(data.data(), data.size()); });
+    default:
+        return elapsed([&]() { radix_sort_msd(data.data(), data.size()); });
+    }
+}
+
+QVector<qint64> parse_list(const QString &list)
+{
+    QVector<qint64> values;
+    for (const QString &value : list.split(',', QString::SkipEmptyParts)) {
+        values << (qint64) value.toDouble();
+    }
+    return values;
+}
+
+/*
+ * Every algorithm on every distribution, size and thread count, as CSV on
+ * stdout. The input is generated again before each repetition, outside of
+ * the measurement, and the best time is kept. std::sort is serial and only
+ * measured once per input.
+ */
+void benchmark_distributions(const QVector<qint64> &sizes, const std::vector<Distribution> &distributions,
+                             const QVector<qint64> &thread_counts, int repeat, quint64 seed)
+{
+    cout << "distribution,n,algorithm,threads,seconds,elements/s" << endl;
+    for (qint64 n : sizes) {
+        std::vector<int32_t> data(n);
+        for (Distribution d : distributions) {
+            for (qint64 threads : thread_counts) {
+                tbb::task_scheduler_init init(threads);
+                for (int a = 0; a < 4; a++) {
+                    if (a == 0 && threads != thread_counts.first())
+                        continue;
+                    double best = 0;
+                    for (int r = 0; r < repeat; r++) {
+                        distribution_generate(d, data.data(), n, seed + r);
+                        double t = sort_once(a, data);
+                        assert(std::is_sorted(data.begin(), data.end()));
+                        best = r == 0 ? t : std::min(best, t);
+                    }
+                    cout << distribution_name(d) << "," << n << "," << ALGORITHMS[a] << ","
+                         << (a == 0 ? 1 : threads) << "," << best << "," << n / best << endl;
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.setApplicationDescription("parallel sorts over input distributions");
+
+    int cpus = tbb::task_scheduler_init::default_num_threads();
+    QString threads;
+    for (int t = 1; t < cpus; t *= 2) {
+        threads += QString::number(t) + ",";
+    }
+    threads += QString::number(cpus);
+
+    QCommandLineOption sizesOption("sizes", "comma separated element counts, up to 1e9", "sizes", "1e6");
+    QCommandLineOption distOption("dist", "comma separated distributions: uniform, sorted, reverse, "
+                                  "nearly-sorted, few-unique, zipf, all-equal", "dist", "all");
+    QCommandLineOption threadsOption("threads", "comma separated thread counts", "threads", threads);
+    QCommandLineOption repeatOption("repeat", "repetitions, the best time is kept", "repeat", "3");
+    QCommandLineOption seedOption("seed", "seed of the generated inputs", "seed", "1");
+    parser.addOption(sizesOption);
+    parser.addOption(distOption);
+    parser.addOption(threadsOption);
+    parser.addOption(repeatOption);
+    parser.addOption(seedOption);
+    parser.process(app);
+
+    std::vector<Distribution> distributions;
+    if (parser.value(distOption) == "all") {
+        distributions = distribution_all();
+    } else {
+        for (const QString &name : parser.value(distOption).split(',', QString::SkipEmptyParts)) {
+            Distribution d;
+            if (!distribution_parse(name.toStdString(), d)) {
+                qDebug() << "unknown distribution" << name;
+                return 1;
+            }
+            distributions.push_back(d);
+        }
+    }
+    QVector<qint64> sizes = parse_list(parser.value(sizesOption));
+    QVector<qint64> thread_counts = parse_list(parser.value(threadsOption));
+    if (sizes.isEmpty() || thread_counts.isEmpty()) {
+        parser.showHelp(1);
+    }
+    benchmark_distributions(sizes, distributions, thread_counts,
+                            std::max(1, parser.value(repeatOption).toInt()),
+                            parser.value(seedOption).toULongLong());
+
+    const int n = 1E6;
+
+    // 64-bit and floating point keys, against tbb::parallel_sort
+    QVector<qint64> longs(n);
+    QVector<float> floats(n);
+    for (int i = 0; i < n; ++i) {
+        longs[i] = (qint64) rand() * rand() - (qint64) rand() * rand();
+        floats[i] = (rand() - RAND_MAX / 2) / 1024.0f;
     }
+    QVector<qint64> longs2 = longs;
+    QVector<float> floats2 = floats;
+    double p64 = elapsed([&]() { tbb::parallel_sort(longs.begin(), longs.end()); });
+    double r64 = elapsed([&]() { radix_sort(longs2.data(), longs2.size()); });
+    assert(longs == longs2);
+    double pf = elapsed([&]() { tbb::parallel_sort(floats.begin(), floats.end()); });
+    double rf = elapsed([&]() { radix_sort(floats2.data(), floats2.size()); });
+    assert(floats == floats2);
 
-    double sum_serial = std::accumulate(serial.begin(), serial.end(), 0.0, std::plus<double>());
-    double sum_parallel = std::accumulate(parallel.begin(), parallel.end(), 0.0, std::plus<double>());
+    print_result("int64 tbb", p64, p64);
+    print_result("int64 radix", p64, r64);
+    print_result("float tbb", pf, pf);
+    print_result("float radix", pf, rf);
 
-    print_result("serial", sum_serial, sum_serial);
-    print_result("parallel", sum_serial, sum_parallel);
+    benchmark_records<64>(n);
+    benchmark_records<128>(n);
 
     return 0;
 }
@@ -0,0 +1,222 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <tbb/tbb.h>
+
+/*
+ * Parallel radix sort of integer and floating point keys, or of records
+ * by such a key.
+ *
+ * Each pass is a stable counting sort on one byte of the key. The input is
+ * cut into blocks, one histogram per block, and an exclusive prefix sum
+ * over (digit, block) gives each block the position of its first element
+ * of each digit, so that the blocks scatter in parallel and the pass stays
+ * stable. The scatter goes through a small buffer per digit, flushed one
+ * cache line at a time, instead of 256 interleaved streams of single
+ * writes. A pass where all the keys have the same byte is skipped.
+ *
+ * radix_sort() is least significant digit first and stable. radix_sort_msd()
+ * starts from the most significant byte and sorts the buckets in parallel
+ * and independently, which suits skewed keys: a bucket that holds most of
+ * the keys is split again on the next byte, the small ones go to
+ * std::sort. It is not stable.
+ */
+
+// order preserving map of a key to an unsigned integer, signed integers
+// have their sign bit flipped
+template<typename K>
+struct radix_key {
+    static_assert(std::is_integral<K>::value, "radix keys are integers or floating point");
+    typedef typename std::make_unsigned<K>::type type;
+    static type encode(K k)
+    {
+        return std::is_signed<K>::value ? (type) k ^ ((type) 1 << (8 * sizeof(K) - 1)) : (type) k;
+    }
+};
+
+// negative floats are ordered backwards: flip all their bits, only the sign otherwise
+template<> struct radix_key<float> {
+    typedef uint32_t type;
+    static uint32_t encode(float k)
+    {
+        uint32_t u;
+        memcpy(&u, &k, sizeof(u));
+        return u ^ ((uint32_t) -(int32_t) (u >> 31) | 0x80000000u);
+    }
+};
+
+template<> struct radix_key<double> {
+    typedef uint64_t type;
+    static uint64_t encode(double k)
+    {
+        uint64_t u;
+        memcpy(&u, &k, sizeof(u));
+        return u ^ ((uint64_t) -(int64_t) (u >> 63) | 0x8000000000000000ull);
+    }
+};
+
+struct radix_identity {
+    template<typename T>
+    const T &operator()(const T &x) const { return x; }
+};
+
+// below this size, a pass is done by a single block
+static const size_t RADIX_BLOCK = 1 << 16;
+// MSD buckets smaller than this are sorted by std::sort
+static const size_t RADIX_MSD_SMALL = 1 << 12;
+
+template<typename T, typename KeyOf>
+struct radix_traits {
+    typedef typename std::decay<decltype(std::declval<KeyOf>()(std::declval<const T &>()))>::type key_type;
+    typedef typename radix_key<key_type>::type unsigned_type;
+
+    static unsigned_type encode(const KeyOf &key_of, const T &x)
+    {
+        return radix_key<key_type>::encode(key_of(x));
+    }
+    static int digit(const KeyOf &key_of, const T &x, int shift)
+    {
+        return (encode(key_of, x) >> shift) & 0xff;
+    }
+};
+
+template<typename T>
+void radix_copy(const T *src, T *dst, size_t n)
+{
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, n, RADIX_BLOCK),
+                      [&](const tbb::blocked_range<size_t> &range) {
+        std::copy(src + range.begin(), src + range.end(), dst + range.begin());
+    });
+}
+
+/*
+ * One stable counting pass on the byte at shift, from src to dst. Returns
+ * false without moving anything when all the keys have the same byte.
+ * counts receives the size of each bucket.
+ */
+template<typename T, typename KeyOf>
+bool radix_pass(const T *src, T *dst, size_t n, int shift, const KeyOf &key_of, size_t counts[256])
+{
+    typedef radix_traits<T, KeyOf> traits;
+    size_t blocks = std::max<size_t>(1, std::min<size_t>(n / RADIX_BLOCK,
+                                     4 * tbb::this_task_arena::max_concurrency()));
+    std::vector<size_t> offsets(blocks * 256, 0);
+
+    tbb::parallel_for(size_t(0), blocks, [&](size_t b) {
+        size_t *hist = &offsets[b * 256];
+        for (size_t i = n * b / blocks; i < n * (b + 1) / blocks; i++) {
+            hist[traits::digit(key_of, src[i], shift)]++;
+        }
+    });
+
+    size_t sum = 0;
+    for (int d = 0; d < 256; d++) {
+        counts[d] = 0;
+        for (size_t b = 0; b < blocks; b++) {
+            size_t c = offsets[b * 256 + d];
+            offsets[b * 256 + d] = sum;
+            sum += c;
+            counts[d] += c;
+        }
+        if (counts[d] == n)
+            return false;
+    }
+
+    // one cache line of elements per digit, at least one element
+    const int line = std::max<int>(1, 64 / sizeof(T));
+    tbb::parallel_for(size_t(0), blocks, [&](size_t b) {
+        size_t *offset = &offsets[b * 256];
+        std::vector<T> buffer(256 * line);
+        int fill[256] = { 0 };
+        for (size_t i = n * b / blocks; i < n * (b + 1) / blocks; i++) {
+            int d = traits::digit(key_of, src[i], shift);
+            buffer[d * line + fill[d]] = src[i];
+            if (++fill[d] == line) {
+                std::copy(&buffer[d * line], &buffer[d * line] + line, dst + offset[d]);
+                offset[d] += line;
+                fill[d] = 0;
+            }
+        }
+        for (int d = 0; d < 256; d++) {
+            std::copy(&buffer[d * line], &buffer[d * line] + fill[d], dst + offset[d]);
+        }
+    });
+    return true;
+}
+
+template<typename T, typename KeyOf>
+void radix_sort(T *data, size_t n, KeyOf key_of)
+{
+    typedef radix_traits<T, KeyOf> traits;
+    std::vector<T> buffer(n);
+    T *src = data;
+    T *dst = buffer.data();
+    size_t counts[256];
+    for (size_t shift = 0; shift < 8 * sizeof(typename traits::unsigned_type); shift += 8) {
+        if (radix_pass(src, dst, n, shift, key_of, counts))
+            std::swap(src, dst);
+    }
+    if (src != data)
+        radix_copy(src, data, n);
+}
+
+template<typename T>
+void radix_sort(T *data, size_t n)
+{
+    radix_sort(data, n, radix_identity());
+}
+
+template<typename T, typename KeyOf>
+void radix_sort_msd_bucket(T *data, T *tmp, size_t n, int shift, const KeyOf &key_of)
+{
+    typedef radix_traits<T, KeyOf> traits;
+    if (n < RADIX_MSD_SMALL) {
+        std::sort(data, data + n, [&](const T &a, const T &b) {
+            return traits::encode(key_of, a) < traits::encode(key_of, b);
+        });
+        return;
+    }
+
+    // bytes shared by all the keys of the bucket are skipped
+    size_t counts[256];
+    while (!radix_pass(data, tmp, n, shift, key_of, counts)) {
+        if (shift == 0)
+            return;
+        shift -= 8;
+    }
+    radix_copy(tmp, data, n);
+    if (shift == 0)
+        return;
+
+    size_t begin[257];
+    begin[0] = 0;
+    for (int d = 0; d < 256; d++) {
+        begin[d + 1] = begin[d] + counts[d];
+    }
+    tbb::parallel_for(0, 256, [&](int d) {
+        radix_sort_msd_bucket(data + begin[d], tmp + begin[d], counts[d], shift - 8, key_of);
+    });
+}
+
+template<typename T, typename KeyOf>
+void radix_sort_msd(T *data, size_t n, KeyOf key_of)
+{
+    typedef radix_traits<T, KeyOf> traits;
+    std::vector<T> buffer(n);
+    int top = 8 * sizeof(typename traits::unsigned_type) - 8;
+    radix_sort_msd_bucket(data, buffer.data(), n, top, key_of);
+}
+
+template<typename T>
+void radix_sort_msd(T *data, size_t n)
+{
+    radix_sort_msd(data, n, radix_identity());
+}
+
+#endif // RADIX_SORT_H
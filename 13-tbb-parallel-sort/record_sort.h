@@ -0,0 +1,105 @@
+#ifndef RECORD_SORT_H
+#define RECORD_SORT_H
+
+#include <cstdint>
+#include <vector>
+#include <tbb/tbb.h>
+
+#include "radix_sort.h"
+
+/*
+ * Sorting records by a key. Sorting the records themselves moves the whole
+ * payload at every pass of a radix sort, or at every swap of a comparison
+ * sort. An argsort sorts (key, index) pairs instead, 16 bytes for a 64-bit
+ * key, and then moves each record once, to its final place, with a
+ * parallel gather. The gather reads the records in random order, so it
+ * pays off when the records are large compared to the pairs.
+ *
+ * Indices are 32-bit, up to 4G records.
+ */
+
+// a 64-bit key followed by its payload, Size bytes in all
+template<int Size>
+struct Record {
+    uint64_t key;
+    char payload[Size - sizeof(uint64_t)];
+};
+
+// the payload of a Record<Size> alone, for a key array next to a payload array
+template<int Size>
+struct Payload {
+    char bytes[Size - sizeof(uint64_t)];
+};
+
+struct record_key {
+    template<typename R>
+    uint64_t operator()(const R &r) const { return r.key; }
+};
+
+template<typename K>
+struct KeyIndex {
+    K key;
+    uint32_t index;
+};
+
+struct key_index_key {
+    template<typename K>
+    K operator()(const KeyIndex<K> &x) const { return x.key; }
+};
+
+// permutation such that keys[perm[i]] is sorted, stable
+template<typename K>
+std::vector<uint32_t> argsort(const K *keys, size_t n)
+{
+    std::vector<KeyIndex<K>> pairs(n);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, n, RADIX_BLOCK),
+                      [&](const tbb::blocked_range<size_t> &range) {
+        for (size_t i = range.begin(); i < range.end(); i++) {
+            pairs[i].key = keys[i];
+            pairs[i].index = i;
+        }
+    });
+    radix_sort(pairs.data(), n, key_index_key());
+
+    std::vector<uint32_t> perm(n);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, n, RADIX_BLOCK),
+                      [&](const tbb::blocked_range<size_t> &range) {
+        for (size_t i = range.begin(); i < range.end(); i++) {
+            perm[i] = pairs[i].index;
+        }
+    });
+    return perm;
+}
+
+// dst[i] = src[perm[i]]
+template<typename T>
+void apply_permutation(const T *src, T *dst, const uint32_t *perm, size_t n)
+{
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, n, 4096),
+                      [&](const tbb::blocked_range<size_t> &range) {
+        for (size_t i = range.begin(); i < range.end(); i++) {
+            dst[i] = src[perm[i]];
+        }
+    });
+}
+
+// sorts the records through an argsort, stable. Each record moves twice,
+// gathered into a buffer and copied back, whatever the width of the key
+template<typename T, typename KeyOf>
+void sort_by_index(T *data, size_t n, KeyOf key_of)
+{
+    typedef typename radix_traits<T, KeyOf>::key_type K;
+    std::vector<K> keys(n);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, n, RADIX_BLOCK),
+                      [&](const tbb::blocked_range<size_t> &range) {
+        for (size_t i = range.begin(); i < range.end(); i++) {
+            keys[i] = key_of(data[i]);
+        }
+    });
+    std::vector<uint32_t> perm = argsort(keys.data(), n);
+    std::vector<T> sorted(n);
+    apply_permutation(data, sorted.data(), perm.data(), n);
+    radix_copy(sorted.data(), data, n);
+}
+
+#endif // RECORD_SORT_H
@@ -15,6 +15,11 @@ LIBS += -ltbb
 TEMPLATE = app
 
 
-SOURCES += main.cpp
+SOURCES += main.cpp \
+    separable.cpp
+
+HEADERS += separable.h
 
 include(../common.pri)
+include(../imaging/imaging.pri)
+include(../tbbtune/tbbtune.pri)
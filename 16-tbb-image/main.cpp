@@ -3,49 +3,520 @@
 #include <QDebug>
 #include <QImage>
 #include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
 #include <QRgb>
+#include <QSet>
 #include <QVector>
 #include <thread>
 #include <iostream>
+#include <memory>
+#include <atomic>
 #include <tbb/tbb.h>
+#include <tbb/flow_graph.h>
+
+#include "bench.h"
+#include "filter.h"
+#include "histogram.h"
+#include "pixel.h"
+#include "planar.h"
+#include "pngwriter.h"
+#include "separable.h"
+#include "stream.h"
+#include "tuned_loop.h"
 
 using namespace std;
 
-void processLine(QImage &img, int dr, int db, int y, int dg)
+void processLine(QImage &img, int dr, int db, int y, int dg, PixelAdjust adjust)
 {
     QRgb *line = (QRgb *) img.scanLine(y);
-    for (int x = 0; x < img.width(); x++) {
-        if (!img.valid(x, y)) {
-            qDebug() << QString("invalid (%1,%2)").arg(x).arg(y);
-        }
-        QRgb *rgb = line + x;
-
-        int r = qBound(0, qRed(*rgb) + dr, 255);
-        int g = qBound(0, qGreen(*rgb) + dg, 255);
-        int b = qBound(0, qBlue(*rgb) + db, 255);
-
-        *rgb = qRgb(r, g, b);
-    }
+    adjust(line, img.width(), dr, dg, db);
 }
 
-void processImage(QImage &img, int cpus)
+// grain and partitioner tuned on the first images, TBBTUNE_FILE keeps them
+static TunedLoop lines("16-process-line");
+
+void processImage(QImage &img, int cpus, PixelAdjust adjust)
 {
-    (void) cpus;
     int dr = 20, dg = 0, db = 0;
     tbb::task_scheduler_init init(cpus);
 
-    // TODO: modify the image in parallel
-    tbb::parallel_for(tbb::blocked_range<int>(0, img.height()), [&](tbb::blocked_range<int> & range) {
+    lines.parallel_for(0, img.height(), [&](tbb::blocked_range<int> & range) {
         for (auto i = range.begin(); i != range.end(); i++) {
-            processLine(img, dr, db, i, dg);
+            processLine(img, dr, db, i, dg, adjust);
         }
     });
 
 //    for (int y = 0; y < img.height(); y++) {
-//        processLine(img, dr, db, y, dg);
+//        processLine(img, dr, db, y, dg, adjust);
 //    }
 }
 
+// the tuning calls rotate the partitioners, they run on a scratch copy before the measurements
+void tuneProcessImage(const QImage &image, int cpus, PixelAdjust adjust)
+{
+    QImage scratch = image.copy();
+    tbb::task_scheduler_init init(cpus);
+    TuneChoice choice;
+    while (scratch.height() > 0 && !lines.tuned(scratch.height(), choice)) {
+        processImage(scratch, cpus, adjust);
+    }
+}
+
+// binds each thread entering the scheduler to the cpu of its slot in the
+// arena, the same cpu however often the threads are re-created or re-join
+class PinningObserver : public tbb::task_scheduler_observer {
+public:
+    PinningObserver() { observe(true); }
+    ~PinningObserver() { observe(false); }
+    void on_scheduler_entry(bool) override
+    {
+        pin_current_thread(tbb::this_task_arena::current_thread_index());
+    }
+};
+
+FilterChain::RowExecutor tbbExecutor()
+{
+    return [](int rows, const FilterChain::RowBody &body) {
+        tbb::parallel_for(tbb::blocked_range<int>(0, rows), [&](const tbb::blocked_range<int> &range) {
+            body(range.begin(), range.end());
+        });
+    };
+}
+
+// the encoding is parallel too, QImage::save() would be the serial tail of each run
+void savePng(const QImage &img, const QString &path)
+{
+    QElapsedTimer timer;
+    timer.start();
+    if (!write_png_parallel(path.toStdString(), (const uint32_t *) img.constBits(),
+                            img.width(), img.height(), img.bytesPerLine() / sizeof(QRgb),
+                            tbbExecutor())) {
+        qDebug() << "error saving image" << path;
+    }
+    qDebug() << "png encode:" << timer.nsecsElapsed();
+}
+
+/*
+ * Apply the filter chain once per stage (unfused) and with the point-wise
+ * stages fused, on a fresh copy of the image for each run.
+ */
+void benchmarkFilter(const QImage &image, const FilterChain &chain, int n, const QString &output)
+{
+    qDebug() << "filter passes:" << chain.passes();
+    QMap<int, qint64> results_unfused;
+    QMap<int, qint64> results_fused;
+    QElapsedTimer timer;
+    for (int cpus = 1; cpus <= n; cpus *= 2) {
+        qDebug() << "threads=" << cpus;
+        tbb::task_scheduler_init init(cpus);
+        QImage img = image.copy();
+        timer.restart();
+        chain.applyUnfused((uint32_t *) img.bits(), img.width(), img.height(),
+                           img.bytesPerLine() / sizeof(QRgb), tbbExecutor());
+        results_unfused[cpus] = timer.nsecsElapsed();
+
+        img = image.copy();
+        timer.restart();
+        chain.apply((uint32_t *) img.bits(), img.width(), img.height(),
+                    img.bytesPerLine() / sizeof(QRgb), tbbExecutor());
+        results_fused[cpus] = timer.nsecsElapsed();
+        savePng(img, output + "." + QString::number(cpus) + ".png");
+    }
+
+    // report: threads;unfused;fused;unfused speedup;fused speedup
+    double baseline = results_unfused[1];
+    for (const int key : results_fused.keys()) {
+        cout << QString("%1;%2;%3;%4;%5")
+                .arg(key)
+                .arg(results_unfused[key])
+                .arg(results_fused[key])
+                .arg(baseline / results_unfused[key])
+                .arg(baseline / results_fused[key])
+                .toStdString() << endl;
+    }
+}
+
+/*
+ * Compare the naive 2D convolution with the tiled separable one. Both
+ * write into a separate output image.
+ */
+void benchmarkConvolve(const QImage &image, const SeparableFilter &filter, int n, const QString &output)
+{
+    QMap<int, qint64> results_naive;
+    QMap<int, qint64> results_separable;
+    QElapsedTimer timer;
+    QImage out(image.width(), image.height(), QImage::Format_RGB32);
+    const uint32_t *src = (const uint32_t *) image.constBits();
+    int src_stride = image.bytesPerLine() / sizeof(QRgb);
+    int dst_stride = out.bytesPerLine() / sizeof(QRgb);
+
+    for (int cpus = 1; cpus <= n; cpus *= 2) {
+        qDebug() << "threads=" << cpus;
+        tbb::task_scheduler_init init(cpus);
+        timer.restart();
+        convolve_naive(src, src_stride, (uint32_t *) out.bits(), dst_stride,
+                       image.width(), image.height(), filter);
+        results_naive[cpus] = timer.nsecsElapsed();
+
+        timer.restart();
+        convolve_separable(src, src_stride, (uint32_t *) out.bits(), dst_stride,
+                           image.width(), image.height(), filter);
+        results_separable[cpus] = timer.nsecsElapsed();
+        savePng(out, output + "." + QString::number(cpus) + ".png");
+    }
+
+    // report: threads;naive;separable;naive speedup;separable speedup
+    double baseline = results_naive[1];
+    for (const int key : results_separable.keys()) {
+        cout << QString("%1;%2;%3;%4;%5")
+                .arg(key)
+                .arg(results_naive[key])
+                .arg(results_separable[key])
+                .arg(baseline / results_naive[key])
+                .arg(baseline / results_separable[key])
+                .toStdString() << endl;
+    }
+}
+
+/*
+ * Histogram equalisation (clip < 0) or auto levels: one sweep builds the
+ * histograms, the second applies the lookup table derived from them.
+ */
+void benchmarkEqualize(const QImage &image, double clip, int n, const QString &output)
+{
+    QMap<int, qint64> results_histogram;
+    QMap<int, qint64> results_apply;
+    QElapsedTimer timer;
+    for (int cpus = 1; cpus <= n; cpus *= 2) {
+        qDebug() << "threads=" << cpus;
+        tbb::task_scheduler_init init(cpus);
+        QImage img = image.copy();
+        uint32_t *bits = (uint32_t *) img.bits();
+        int stride = img.bytesPerLine() / sizeof(QRgb);
+        Histogram hist;
+        uint8_t lut[3][256];
+        timer.restart();
+        histogram_build(bits, img.width(), img.height(), stride, hist, tbbExecutor());
+        if (clip < 0)
+            equalize_lut(hist, lut);
+        else
+            levels_lut(hist, clip, lut);
+        results_histogram[cpus] = timer.nsecsElapsed();
+
+        FilterChain chain;
+        chain.lut(lut);
+        timer.restart();
+        chain.apply(bits, img.width(), img.height(), stride, tbbExecutor());
+        results_apply[cpus] = timer.nsecsElapsed();
+        savePng(img, output + "." + QString::number(cpus) + ".png");
+    }
+
+    // report: threads;histogram;apply;total;speedup
+    double baseline = results_histogram[1] + results_apply[1];
+    for (const int key : results_histogram.keys()) {
+        qint64 total = results_histogram[key] + results_apply[key];
+        cout << QString("%1;%2;%3;%4;%5")
+                .arg(key)
+                .arg(results_histogram[key])
+                .arg(results_apply[key])
+                .arg(total)
+                .arg(baseline / total)
+                .toStdString() << endl;
+    }
+}
+
+/*
+ * Colour shift followed by grayscale, repeated passes times, on the packed
+ * image and on its planar copy. The planar timing includes the conversion
+ * to planes and back, paid once whatever the number of passes.
+ */
+void benchmarkPlanar(const QImage &image, int n, const QString &output)
+{
+    tbb::task_scheduler_init init(n);
+    FilterChain::RowExecutor exec = tbbExecutor();
+    PixelAdjust simd = pixel_adjust_best();
+    FilterChain gray;
+    gray.grayscale();
+    QElapsedTimer timer;
+    QImage img;
+    QMap<int, qint64> results_packed;
+    QMap<int, qint64> results_planar;
+    QMap<int, qint64> results_conversion;
+    for (int passes = 1; passes <= 16; passes *= 2) {
+        qDebug() << "passes=" << passes;
+        img = image.copy();
+        uint32_t *bits = (uint32_t *) img.bits();
+        int stride = img.bytesPerLine() / sizeof(QRgb);
+        timer.restart();
+        for (int i = 0; i < passes; i++) {
+            exec(img.height(), [&](int y0, int y1) {
+                for (int y = y0; y < y1; y++) {
+                    simd(bits + (size_t) y * stride, img.width(), 20, 0, -20);
+                }
+            });
+            gray.apply(bits, img.width(), img.height(), stride, exec);
+        }
+        results_packed[passes] = timer.nsecsElapsed();
+
+        img = image.copy();
+        bits = (uint32_t *) img.bits();
+        PlanarImage planes;
+        qint64 conversion = 0;
+        timer.restart();
+        planar_split(bits, img.width(), img.height(), stride, planes, exec);
+        conversion += timer.nsecsElapsed();
+        for (int i = 0; i < passes; i++) {
+            planar_shift(planes, 20, 0, -20, exec);
+            planar_grayscale(planes, exec);
+        }
+        qint64 split_done = timer.nsecsElapsed();
+        planar_merge(planes, bits, stride, exec);
+        results_planar[passes] = timer.nsecsElapsed();
+        results_conversion[passes] = conversion + results_planar[passes] - split_done;
+    }
+    savePng(img, output + ".planar.png");
+
+    // report: passes;packed;planar;conversion;planar speedup
+    for (const int key : results_packed.keys()) {
+        cout << QString("%1;%2;%3;%4;%5")
+                .arg(key)
+                .arg(results_packed[key])
+                .arg(results_planar[key])
+                .arg(results_conversion[key])
+                .arg((double) results_packed[key] / results_planar[key])
+                .toStdString() << endl;
+    }
+}
+
+/*
+ * Colour shift timed over warmup and measured trials for every thread count
+ * from 1 to n. Each trial processes a pristine copy of the image, made
+ * outside of the timed region.
+ */
+void benchmarkTrials(const QImage &image, int n, int warmups, int trials, bool pin)
+{
+    FilterChain::RowExecutor exec = tbbExecutor();
+    unique_ptr<PinningObserver> pinning;
+    if (pin)
+        pinning.reset(new PinningObserver());
+    PixelAdjust kernels[] = { pixel_adjust_scalar, pixel_adjust_best() };
+    QImage img;
+    double baseline = 0;
+    cout << "threads,kernel," << trial_csv_header() << ",speedup" << endl;
+    for (int cpus = 1; cpus <= n; cpus++) {
+        tbb::task_scheduler_init init(cpus);
+        for (PixelAdjust adjust : kernels) {
+            TrialStats stats = run_trials([&]() {
+                img = image.copy();
+            }, [&]() {
+                uint32_t *bits = (uint32_t *) img.bits();
+                int stride = img.bytesPerLine() / sizeof(QRgb);
+                exec(img.height(), [&](int y0, int y1) {
+                    for (int y = y0; y < y1; y++) {
+                        adjust(bits + (size_t) y * stride, img.width(), 20, 0, 0);
+                    }
+                });
+            }, warmups, trials);
+            if (baseline == 0)
+                baseline = stats.median;
+            cout << cpus << "," << pixel_adjust_name(adjust) << "," << trial_csv(stats)
+                 << "," << baseline / stats.median << endl;
+        }
+    }
+}
+
+/*
+ * Out of core processing: strips are decoded, filtered and encoded in a
+ * pipeline, at most tokens strips are in memory at any time.
+ */
+bool streamImage(const QString &input, const QString &output, const FilterChain &chain,
+                 int strip_rows, int tokens)
+{
+    unique_ptr<StripReader> reader(StripReader::open(input.toStdString()));
+    if (!reader) {
+        qDebug() << "error opening image" << input;
+        return false;
+    }
+    unique_ptr<StripWriter> writer(StripWriter::create(output.toStdString(),
+                                                           reader->width(), reader->height()));
+    if (!writer) {
+        qDebug() << "error creating image" << output;
+        return false;
+    }
+
+    StripSource source(reader.get(), strip_rows, chain.halo());
+    bool write_ok = true;
+    int strips = 0;
+    QElapsedTimer timer;
+    timer.start();
+    tbb::parallel_pipeline(tokens,
+        tbb::make_filter<void, Strip *>(tbb::filter::serial_in_order,
+            [&](tbb::flow_control &fc) -> Strip * {
+                Strip *strip = new Strip();
+                if (!source.next(*strip)) {
+                    delete strip;
+                    fc.stop();
+                    return nullptr;
+                }
+                return strip;
+            }) &
+        tbb::make_filter<Strip *, Strip *>(tbb::filter::parallel,
+            [&](Strip *strip) {
+                chain.apply(strip->pixels.data(), strip->width, strip->total,
+                            strip->width, tbbExecutor());
+                return strip;
+            }) &
+        tbb::make_filter<Strip *, void>(tbb::filter::serial_in_order,
+            [&](Strip *strip) {
+                write_ok = write_ok && writer->writeRows(strip->output(), strip->rows, strip->width);
+                strips++;
+                delete strip;
+            }));
+    write_ok = write_ok && writer->finish();
+    qint64 elapsed = timer.nsecsElapsed();
+
+    if (source.failed() || !write_ok) {
+        qDebug() << "error streaming" << input << "to" << output;
+        return false;
+    }
+
+    // report: width;height;strips;tokens;elapsed
+    cout << QString("%1;%2;%3;%4;%5")
+            .arg(reader->width())
+            .arg(reader->height())
+            .arg(strips)
+            .arg(tokens)
+            .arg(elapsed)
+            .toStdString() << endl;
+    return true;
+}
+
+struct BatchItem {
+    QString input;
+    QString output;
+    QImage image;
+};
+
+// images of a directory, or the paths listed one per line in a file
+QStringList batchInputs(const QString &input)
+{
+    QStringList paths;
+    QFileInfo info(input);
+    if (info.isDir()) {
+        QDir dir(input);
+        QStringList filters;
+        filters << "*.png" << "*.jpg" << "*.jpeg" << "*.bmp" << "*.ppm" << "*.tif" << "*.tiff";
+        for (const QString &name : dir.entryList(filters, QDir::Files, QDir::Name)) {
+            paths << dir.filePath(name);
+        }
+    } else {
+        QFile file(input);
+        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            QTextStream stream(&file);
+            while (!stream.atEnd()) {
+                QString line = stream.readLine().trimmed();
+                if (!line.isEmpty())
+                    paths << line;
+            }
+        }
+    }
+    return paths;
+}
+
+/*
+ * Batch processing: a flow graph decodes, filters and encodes many images,
+ * the limiter keeps at most tokens images in memory and the io concurrency
+ * bounds the decode and encode nodes. Decoding one image overlaps with the
+ * processing and encoding of the others.
+ */
+bool batchImages(const QString &input, const QString &output, const FilterChain &chain,
+                 int tokens, int io)
+{
+    QStringList paths = batchInputs(input);
+    if (paths.isEmpty()) {
+        qDebug() << "no images in" << input;
+        return false;
+    }
+    if (!QDir().mkpath(output)) {
+        qDebug() << "error creating directory" << output;
+        return false;
+    }
+    QDir outdir(output);
+
+    std::atomic<int> failed(0);
+    QElapsedTimer timer;
+    timer.start();
+
+    tbb::flow::graph g;
+    tbb::flow::queue_node<BatchItem> queue(g);
+    tbb::flow::limiter_node<BatchItem> limiter(g, tokens);
+    tbb::flow::function_node<BatchItem, BatchItem> decode(g, io, [](BatchItem item) {
+        if (item.image.load(item.input))
+            item.image = item.image.convertToFormat(QImage::Format_RGB32);
+        return item;
+    });
+    tbb::flow::function_node<BatchItem, BatchItem> process(g, tbb::flow::unlimited,
+            [&](BatchItem item) {
+        if (!item.image.isNull()) {
+            chain.apply((uint32_t *) item.image.bits(), item.image.width(), item.image.height(),
+                        item.image.bytesPerLine() / sizeof(QRgb), tbbExecutor());
+        }
+        return item;
+    });
+    tbb::flow::function_node<BatchItem, tbb::flow::continue_msg> encode(g, io,
+            [&](const BatchItem &item) {
+        if (item.image.isNull() ||
+                !write_png_parallel(item.output.toStdString(), (const uint32_t *) item.image.constBits(),
+                                    item.image.width(), item.image.height(),
+                                    item.image.bytesPerLine() / sizeof(QRgb), tbbExecutor())) {
+            qDebug() << "error processing" << item.input;
+            failed++;
+        }
+        return tbb::flow::continue_msg();
+    });
+
+    tbb::flow::make_edge(queue, limiter);
+    tbb::flow::make_edge(limiter, decode);
+    tbb::flow::make_edge(decode, process);
+    tbb::flow::make_edge(process, encode);
+    tbb::flow::make_edge(encode, limiter.decrement);
+
+    // the queue holds the paths only, images exist between limiter and encode.
+    // a.png and a.jpg would be encoded into the same file, the second one
+    // keeps its suffix: a.jpg.png
+    QSet<QString> names;
+    for (const QString &path : paths) {
+        QFileInfo info(path);
+        QString name = info.completeBaseName();
+        if (names.contains(name))
+            name = info.completeBaseName() + "." + info.suffix();
+        for (int i = 2; names.contains(name); i++) {
+            name = info.completeBaseName() + "-" + QString::number(i);
+        }
+        names.insert(name);
+
+        BatchItem item;
+        item.input = path;
+        item.output = outdir.filePath(name + ".png");
+        queue.try_put(item);
+    }
+    g.wait_for_all();
+    qint64 elapsed = timer.nsecsElapsed();
+
+    // report: images;failed;tokens;io;elapsed;images per second
+    cout << QString("%1;%2;%3;%4;%5;%6")
+            .arg(paths.size())
+            .arg(failed.load())
+            .arg(tokens)
+            .arg(io)
+            .arg(elapsed)
+            .arg(paths.size() / (elapsed / 1e9))
+            .toStdString() << endl;
+    return failed.load() == 0;
+}
+
 int main(int argc, char *argv[])
 {
 
@@ -60,6 +531,48 @@ int main(int argc, char *argv[])
     QCommandLineOption outOption("output", "output image", "output");
     parser.addOption(outOption);
 
+    QCommandLineOption filterOption("filter",
+            "filter chain, e.g. shift:20,0,0;gamma:2.2;gray;threshold:128;blur", "filter");
+    parser.addOption(filterOption);
+
+    QCommandLineOption equalizeOption("equalize",
+            "histogram equalisation or auto levels [ equalize | levels[:clip percent] ]", "equalize");
+    parser.addOption(equalizeOption);
+
+    QCommandLineOption planarOption("planar", "compare packed and planar point-wise filters");
+    parser.addOption(planarOption);
+
+    QCommandLineOption trialsOption("trials",
+            "measured trials per thread count, from 1 to all cpus, CSV output", "trials");
+    parser.addOption(trialsOption);
+
+    QCommandLineOption warmupOption("warmup", "warmup trials per thread count", "warmup", "2");
+    parser.addOption(warmupOption);
+
+    QCommandLineOption pinOption("pin", "bind each thread to a cpu");
+    parser.addOption(pinOption);
+
+    QCommandLineOption convolveOption("convolve",
+            "separable convolution [ gauss:sigma | box:radius | sobel ]", "convolve");
+    parser.addOption(convolveOption);
+
+    QCommandLineOption streamOption("stream",
+            "process the image by strips without loading it (PNG or PPM)");
+    parser.addOption(streamOption);
+
+    QCommandLineOption stripOption("strip", "rows per strip", "strip", "256");
+    parser.addOption(stripOption);
+
+    QCommandLineOption tokensOption("tokens", "strips or images in flight", "tokens", "4");
+    parser.addOption(tokensOption);
+
+    QCommandLineOption batchOption("batch",
+            "input is a directory or a file listing images, output a directory");
+    parser.addOption(batchOption);
+
+    QCommandLineOption ioOption("io", "concurrent decodes and encodes in batch mode", "io", "4");
+    parser.addOption(ioOption);
+
     parser.process(app);
 
     if (!parser.isSet(inOption)) {
@@ -77,6 +590,25 @@ int main(int argc, char *argv[])
     qDebug() << "output:" << output;
     qDebug() << "num cpus:" << n;
 
+    if (parser.isSet(streamOption) || parser.isSet(batchOption)) {
+        FilterChain chain;
+        QString spec = parser.isSet(filterOption) ? parser.value(filterOption) : "shift:20,0,0";
+        if (!chain.parse(spec.toStdString())) {
+            qDebug() << "invalid filter" << spec;
+            return 1;
+        }
+        int tokens = qMax(1, parser.value(tokensOption).toInt());
+        if (parser.isSet(batchOption)) {
+            int io = qMax(1, parser.value(ioOption).toInt());
+            return batchImages(input, output, chain, tokens, io) ? 0 : 1;
+        }
+        int strip_rows = qMax(1, parser.value(stripOption).toInt());
+        if (!parser.isSet(outOption)) {
+            output += ".png";
+        }
+        return streamImage(input, output, chain, strip_rows, tokens) ? 0 : 1;
+    }
+
     QImage image;
     if (!image.load(input)) {
         qDebug() << "error loading image" << input;
@@ -84,25 +616,81 @@ int main(int argc, char *argv[])
     }
     image = image.convertToFormat(QImage::Format_RGB32);
 
+    FilterChain chain;
+    if (parser.isSet(planarOption)) {
+        benchmarkPlanar(image, n, output);
+        return 0;
+    }
+
+    if (parser.isSet(equalizeOption)) {
+        QStringList spec = parser.value(equalizeOption).split(':');
+        double clip = -1;
+        if (spec[0] == "levels") {
+            clip = spec.size() > 1 ? spec[1].toDouble() / 100 : 0.005;
+        } else if (spec[0] != "equalize") {
+            qDebug() << "invalid equalisation" << parser.value(equalizeOption);
+            return 1;
+        }
+        benchmarkEqualize(image, clip, n, output);
+        return 0;
+    }
+
+    if (parser.isSet(filterOption)) {
+        if (!chain.parse(parser.value(filterOption).toStdString())) {
+            qDebug() << "invalid filter" << parser.value(filterOption);
+            return 1;
+        }
+        benchmarkFilter(image, chain, n, output);
+        return 0;
+    }
+
+    if (parser.isSet(convolveOption)) {
+        SeparableFilter filter;
+        if (!SeparableFilter::parse(parser.value(convolveOption).toStdString(), filter)) {
+            qDebug() << "invalid convolution" << parser.value(convolveOption);
+            return 1;
+        }
+        benchmarkConvolve(image, filter, n, output);
+        return 0;
+    }
+
+    if (parser.isSet(trialsOption)) {
+        benchmarkTrials(image, n, qMax(0, parser.value(warmupOption).toInt()),
+                        qMax(1, parser.value(trialsOption).toInt()), parser.isSet(pinOption));
+        return 0;
+    }
+
     // benchmark
+    PixelAdjust simd = pixel_adjust_best();
+    qDebug() << "simd:" << pixel_adjust_name(simd);
     QMap<int, qint64> results;
+    QMap<int, qint64> results_simd;
     QElapsedTimer timer;
     for (int cpus = 1; cpus <= n; cpus *= 2) {
         qDebug() << "threads=" << cpus;
+        tuneProcessImage(image, cpus, pixel_adjust_scalar);
+        QImage img = image.copy();
         timer.restart();
-        processImage(image, cpus);
+        processImage(img, cpus, pixel_adjust_scalar);
         results[cpus] = timer.nsecsElapsed();
-        image.save(output + "." + QString::number(cpus) + ".png");
+        img = image.copy();
+        timer.restart();
+        processImage(img, cpus, simd);
+        results_simd[cpus] = timer.nsecsElapsed();
+        savePng(img, output + "." + QString::number(cpus) + ".png");
     }
 
-    // report
+    // report: threads;scalar;simd;scalar speedup;simd speedup
     double baseline = results[1];
     for (const int key : results.keys()) {
         double speedup = baseline / results[key];
-        cout << QString("%1;%2;%3")
+        double speedup_simd = baseline / results_simd[key];
+        cout << QString("%1;%2;%3;%4;%5")
                 .arg(key)
                 .arg(results[key])
+                .arg(results_simd[key])
                 .arg(speedup)
+                .arg(speedup_simd)
                 .toStdString() << endl;
     }
 
@@ -0,0 +1,220 @@
+#include "separable.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <emmintrin.h>
+#include <tbb/tbb.h>
+
+// four floats per pixel, 16 bytes aligned
+typedef std::vector<float, tbb::cache_aligned_allocator<float> > PixelBuffer;
+
+struct TileScratch {
+    PixelBuffer row;
+    PixelBuffer pass1;
+    PixelBuffer pass2;
+};
+
+static inline int clamp(int x, int lo, int hi)
+{
+    return x < lo ? lo : (x > hi ? hi : x);
+}
+
+static inline __m128 load_pixel(uint32_t p)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i v = _mm_cvtsi32_si128(p);
+    v = _mm_unpacklo_epi8(v, zero);
+    v = _mm_unpacklo_epi16(v, zero);
+    return _mm_cvtepi32_ps(v);
+}
+
+// round, saturate to [0, 255] and set alpha
+static inline uint32_t store_pixel(__m128 v)
+{
+    __m128i i = _mm_cvtps_epi32(v);
+    i = _mm_packs_epi32(i, i);
+    i = _mm_packus_epi16(i, i);
+    return _mm_cvtsi128_si32(i) | 0xff000000u;
+}
+
+SeparableFilter SeparableFilter::gaussian(float sigma)
+{
+    SeparableFilter filter;
+    int radius = std::max(1, (int) std::ceil(3 * sigma));
+    float sum = 0;
+    for (int i = -radius; i <= radius; i++) {
+        float w = std::exp(-(i * i) / (2 * sigma * sigma));
+        filter.h1.push_back(w);
+        sum += w;
+    }
+    for (float &w : filter.h1) {
+        w /= sum;
+    }
+    filter.v1 = filter.h1;
+    return filter;
+}
+
+SeparableFilter SeparableFilter::box(int radius)
+{
+    SeparableFilter filter;
+    filter.h1.assign(2 * radius + 1, 1.0f / (2 * radius + 1));
+    filter.v1 = filter.h1;
+    return filter;
+}
+
+SeparableFilter SeparableFilter::sobel()
+{
+    SeparableFilter filter;
+    filter.h1 = { -1, 0, 1 };
+    filter.v1 = { 1, 2, 1 };
+    filter.h2 = { 1, 2, 1 };
+    filter.v2 = { -1, 0, 1 };
+    return filter;
+}
+
+bool SeparableFilter::parse(const std::string &spec, SeparableFilter &filter)
+{
+    std::string name = spec.substr(0, spec.find(':'));
+    std::string arg = spec.find(':') == std::string::npos ? "" : spec.substr(spec.find(':') + 1);
+    if (name == "gauss") {
+        float sigma = arg.empty() ? 1.0f : atof(arg.c_str());
+        if (sigma <= 0)
+            return false;
+        filter = gaussian(sigma);
+    } else if (name == "box") {
+        int radius = arg.empty() ? 1 : atoi(arg.c_str());
+        if (radius <= 0)
+            return false;
+        filter = box(radius);
+    } else if (name == "sobel") {
+        filter = sobel();
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Horizontal pass over rows [y0 - rv, y1 + rv) and columns [x0, x1) into
+ * out, then vertical pass into acc for the rows [y0, y1).
+ */
+static void tile_pass(const uint32_t *src, int src_stride, int width, int height,
+                      const std::vector<float> &h, const std::vector<float> &v,
+                      int x0, int x1, int y0, int y1, TileScratch &scratch, PixelBuffer &out)
+{
+    int rh = h.size() / 2;
+    int rv = v.size() / 2;
+    int tw = x1 - x0;
+    int rows = (y1 - y0) + 2 * rv;
+
+    scratch.row.resize(4 * (tw + 2 * rh));
+    out.resize(4 * (size_t) rows * tw);
+
+    for (int r = 0; r < rows; r++) {
+        const uint32_t *line = src + (size_t) clamp(y0 - rv + r, 0, height - 1) * src_stride;
+        float *row = scratch.row.data();
+        for (int x = 0; x < tw + 2 * rh; x++) {
+            _mm_store_ps(row + 4 * x, load_pixel(line[clamp(x0 - rh + x, 0, width - 1)]));
+        }
+        float *o = out.data() + 4 * (size_t) r * tw;
+        for (int x = 0; x < tw; x++) {
+            __m128 acc = _mm_setzero_ps();
+            for (int k = 0; k < (int) h.size(); k++) {
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(h[k]), _mm_load_ps(row + 4 * (x + k))));
+            }
+            _mm_store_ps(o + 4 * x, acc);
+        }
+    }
+
+    // vertical pass in place: row r only reads rows r..r + 2 * rv
+    for (int r = 0; r < y1 - y0; r++) {
+        float *o = out.data() + 4 * (size_t) r * tw;
+        for (int x = 0; x < tw; x++) {
+            __m128 acc = _mm_setzero_ps();
+            for (int k = 0; k < (int) v.size(); k++) {
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(v[k]), _mm_load_ps(o + 4 * ((size_t) k * tw + x))));
+            }
+            _mm_store_ps(o + 4 * x, acc);
+        }
+    }
+}
+
+void convolve_separable(const uint32_t *src, int src_stride, uint32_t *dst, int dst_stride,
+                        int width, int height, const SeparableFilter &filter,
+                        int tile_width, int tile_height)
+{
+    tbb::enumerable_thread_specific<TileScratch> scratch;
+    bool gradient = !filter.h2.empty();
+
+    tbb::parallel_for(tbb::blocked_range2d<int>(0, height, tile_height, 0, width, tile_width),
+        [&](const tbb::blocked_range2d<int> &range) {
+            TileScratch &local = scratch.local();
+            int y0 = range.rows().begin(), y1 = range.rows().end();
+            int x0 = range.cols().begin(), x1 = range.cols().end();
+            int tw = x1 - x0;
+
+            tile_pass(src, src_stride, width, height, filter.h1, filter.v1,
+                      x0, x1, y0, y1, local, local.pass1);
+            if (gradient) {
+                tile_pass(src, src_stride, width, height, filter.h2, filter.v2,
+                          x0, x1, y0, y1, local, local.pass2);
+            }
+
+            for (int y = y0; y < y1; y++) {
+                const float *g1 = local.pass1.data() + 4 * (size_t) (y - y0) * tw;
+                const float *g2 = local.pass2.data() + 4 * (size_t) (y - y0) * tw;
+                uint32_t *line = dst + (size_t) y * dst_stride + x0;
+                for (int x = 0; x < tw; x++) {
+                    __m128 p = _mm_load_ps(g1 + 4 * x);
+                    if (gradient) {
+                        __m128 q = _mm_load_ps(g2 + 4 * x);
+                        p = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(p, p), _mm_mul_ps(q, q)));
+                    }
+                    line[x] = store_pixel(p);
+                }
+            }
+    });
+}
+
+static void naive_pixel(const uint32_t *src, int src_stride, int width, int height,
+                        const std::vector<float> &h, const std::vector<float> &v,
+                        int x, int y, float *acc)
+{
+    int rh = h.size() / 2;
+    int rv = v.size() / 2;
+    acc[0] = acc[1] = acc[2] = 0;
+    for (int i = 0; i < (int) v.size(); i++) {
+        const uint32_t *line = src + (size_t) clamp(y + i - rv, 0, height - 1) * src_stride;
+        for (int j = 0; j < (int) h.size(); j++) {
+            uint32_t p = line[clamp(x + j - rh, 0, width - 1)];
+            float w = v[i] * h[j];
+            acc[0] += w * ((p >> 16) & 0xff);
+            acc[1] += w * ((p >> 8) & 0xff);
+            acc[2] += w * (p & 0xff);
+        }
+    }
+}
+
+void convolve_naive(const uint32_t *src, int src_stride, uint32_t *dst, int dst_stride,
+                    int width, int height, const SeparableFilter &filter)
+{
+    bool gradient = !filter.h2.empty();
+    tbb::parallel_for(tbb::blocked_range<int>(0, height), [&](const tbb::blocked_range<int> &range) {
+        for (int y = range.begin(); y < range.end(); y++) {
+            for (int x = 0; x < width; x++) {
+                float g1[3], g2[3];
+                int c[3];
+                naive_pixel(src, src_stride, width, height, filter.h1, filter.v1, x, y, g1);
+                if (gradient)
+                    naive_pixel(src, src_stride, width, height, filter.h2, filter.v2, x, y, g2);
+                for (int k = 0; k < 3; k++) {
+                    float p = gradient ? std::sqrt(g1[k] * g1[k] + g2[k] * g2[k]) : g1[k];
+                    c[k] = clamp((int) std::lround(p), 0, 255);
+                }
+                dst[(size_t) y * dst_stride + x] = 0xff000000u | (c[0] << 16) | (c[1] << 8) | c[2];
+            }
+        }
+    });
+}
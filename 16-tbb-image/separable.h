@@ -0,0 +1,41 @@
+#ifndef SEPARABLE_H
+#define SEPARABLE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Separable convolution of 0xAARRGGBB images (QImage::Format_RGB32). A 2D
+ * kernel that is the outer product v * h is applied as a horizontal pass
+ * with h followed by a vertical pass with v. Edges are clamped.
+ *
+ * When a second pair (h2, v2) is set, both convolutions are computed and
+ * the result is the gradient magnitude sqrt(g1^2 + g2^2), as for Sobel.
+ */
+struct SeparableFilter {
+    std::vector<float> h1, v1;
+    std::vector<float> h2, v2;
+
+    static SeparableFilter gaussian(float sigma);
+    static SeparableFilter box(int radius);
+    static SeparableFilter sobel();
+    // gauss:sigma, box:radius or sobel
+    static bool parse(const std::string &spec, SeparableFilter &filter);
+};
+
+/*
+ * The image is split in tiles with tbb::blocked_range2d. Each tile converts
+ * its rows, plus the halo rows needed by the vertical pass, to float pixels
+ * in thread-local scratch and runs both passes there, four channels per
+ * SSE register.
+ */
+void convolve_separable(const uint32_t *src, int src_stride, uint32_t *dst, int dst_stride,
+                        int width, int height, const SeparableFilter &filter,
+                        int tile_width = 256, int tile_height = 64);
+
+// reference: full 2D kernel per pixel, rows in parallel
+void convolve_naive(const uint32_t *src, int src_stride, uint32_t *dst, int dst_stride,
+                    int width, int height, const SeparableFilter &filter);
+
+#endif // SEPARABLE_H
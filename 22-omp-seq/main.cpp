@@ -1,8 +1,10 @@
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QTextStream>
 #include <QProcess>
 #include <math.h>
+#include <omp.h>
 #include <iostream>
 
 QString gnuplot(
@@ -38,6 +40,46 @@ void write_data(QVector<float> &orig, QVector<float> &norm)
     process.waitForFinished();
 }
 
+float energy_reduction(const QVector<float> &x)
+{
+    float sum = 0;
+    #pragma omp parallel for reduction(+:sum)
+    for (int i = 0; i < x.size(); i++) {
+        sum += x[i] * x[i];
+    }
+    return sum;
+}
+
+/*
+ * The max is exact whatever the order, but a float sum is not: with
+ * reduction(+:) the partial sums of the threads are combined in an order
+ * that depends on the team size. Here the blocks do not depend on the
+ * number of threads, and neither does the combination tree of the block
+ * sums, so the result is bit-identical for any team size.
+ */
+float energy_deterministic(const QVector<float> &x, int block = 4096)
+{
+    int nblocks = (x.size() + block - 1) / block;
+    if (nblocks == 0)
+        return 0;
+    QVector<float> partial(nblocks);
+    #pragma omp parallel for schedule(static)
+    for (int b = 0; b < nblocks; b++) {
+        int end = std::min<int>(x.size(), (b + 1) * block);
+        float sum = 0;
+        for (int i = b * block; i < end; i++) {
+            sum += x[i] * x[i];
+        }
+        partial[b] = sum;
+    }
+    for (int stride = 1; stride < nblocks; stride *= 2) {
+        for (int b = 0; b + stride < nblocks; b += 2 * stride) {
+            partial[b] += partial[b + stride];
+        }
+    }
+    return partial[0];
+}
+
 int main(int argc, char *argv[])
 {
     (void) argc; (void) argv;
@@ -101,6 +143,34 @@ int main(int argc, char *argv[])
 
     qDebug() << "check amplitude2=" << amplitude2;
 
+    // energy of a longer signal, for each team size
+    QVector<float> signal(1 << 24);
+    #pragma omp parallel for private(t)
+    for (i = 0; i < signal.size(); i++) {
+        t = i * p;
+        signal[i] = std::cos((t + 0.1) * 0.1) +
+                    std::cos((t + 0.2) * 0.2) +
+                    std::cos((t + 0.3) * 0.3);
+    }
+
+    int max_threads = omp_get_max_threads();
+    for (int threads = 1; threads <= max_threads; threads++) {
+        omp_set_num_threads(threads);
+        QElapsedTimer timer;
+        timer.start();
+        float e1 = energy_reduction(signal);
+        qint64 t1 = timer.restart();
+        float e2 = energy_deterministic(signal);
+        qint64 t2 = timer.elapsed();
+        qDebug() << QString("threads=%1 reduction=%2 (%3 ms) deterministic=%4 (%5 ms)")
+                    .arg(threads)
+                    .arg(e1, 0, 'g', 9)
+                    .arg(t1)
+                    .arg(e2, 0, 'g', 9)
+                    .arg(t2);
+    }
+    omp_set_num_threads(max_threads);
+
     write_data(orig, norm);
 
     return 0;
@@ -12,3 +12,4 @@ TEMPLATE = app
 
 SOURCES += main.cpp
 
+include(../tbbtune/tbbtune.pri)
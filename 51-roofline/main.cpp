@@ -3,7 +3,10 @@
 #include <QMap>
 #include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
 #include "tbb/tbb.h"
+#include "tuned_loop.h"
 #include <mmintrin.h>
 
 // compute peak FP
@@ -15,13 +18,21 @@ typedef struct sample {
     double fp;
 } sample_t;
 
-sample_t benchmark(std::function<void (int)> fn, int cpus, int op, qint64 flops, qint64 bytes)
+sample_t benchmark(std::function<void (int)> fn, TunedLoop &loop, qint64 trip,
+                   int cpus, int op, qint64 flops, qint64 bytes)
 {
     sample_t sample;
     int max_repeat = 3;
     double sum = 0;
     QElapsedTimer time;
     tbb::task_scheduler_init sched(cpus);
+    // tune the grain size and partitioner before the measurement
+    TuneChoice choice;
+    while (!loop.tuned(trip, choice)) {
+        fn(op);
+    }
+    qDebug() << QString::fromStdString(loop.name()) << "cpus=" << cpus
+             << QString::fromStdString(choice.toString());
     for (int repeat = 0; repeat < max_repeat; repeat++) {
         qint64 t1 = time.nsecsElapsed();
         fn(op);
@@ -67,8 +78,16 @@ int main(int argc, char *argv[])
     v2.fill(0, size);
     v3.fill(0, size);
 
+    // the best grain depends on the arithmetic intensity, one loop per ops
+    TunedLoop flopsLoop("roofline-flops");
+    TunedLoop bandwidthLoop("roofline-bandwidth");
+    std::map<int, std::unique_ptr<TunedLoop> > rooflineLoops;
+    for (int ops : nops) {
+        rooflineLoops[ops].reset(new TunedLoop(QString("roofline-%1").arg(ops).toStdString()));
+    }
+
     auto roofline = [&](int op) {
-        tbb::parallel_for(tbb::blocked_range<int>(0, size / 8),
+        rooflineLoops[op]->parallel_for(0, int(size / 8),
             [&](tbb::blocked_range<int> &range) {
                 for (int i = range.begin(); i < range.end(); i++) {
                     // 32 * 4 bytes for each (size / 8) = 16 * size bytes
@@ -97,7 +116,7 @@ int main(int argc, char *argv[])
     __m128 A, B, C, D;
     A = B = C = D = _mm_set1_ps(3.14159);
     auto flops = [&](int op) { (void) op;
-        tbb::parallel_for(tbb::blocked_range<int>(0, size / 8),
+        flopsLoop.parallel_for(0, int(size / 8),
             [&](tbb::blocked_range<int> &range) {
                 for (int i = range.begin(); i < range.end(); i++) {
                     // 16 flops for each (size / 8) == 2 * size flops
@@ -112,7 +131,7 @@ int main(int argc, char *argv[])
     };
 
     auto bandwidth = [&](int op) { (void) op;
-        tbb::parallel_for(tbb::blocked_range<int>(0, size / 8),
+        bandwidthLoop.parallel_for(0, int(size / 8),
             [&](tbb::blocked_range<int> &range) {
                 for (int i = range.begin(); i < range.end(); i++) {
                     // 16 * 8 for each (size / 8) == 16 * size bytes
@@ -130,13 +149,14 @@ int main(int argc, char *argv[])
         );
     };
 
-    sample_t fp_res = benchmark(flops, nrcpus, 0, 2 * size, 0);
-    sample_t bw_res = benchmark(bandwidth, nrcpus, 0, 0, 16 * size);
+    sample_t fp_res = benchmark(flops, flopsLoop, size / 8, nrcpus, 0, 2 * size, 0);
+    sample_t bw_res = benchmark(bandwidth, bandwidthLoop, size / 8, nrcpus, 0, 0, 16 * size);
 
     QMap<int, QMap<int, sample_t> > map;
     for (int cpus : ncpus) {
         for (int ops : nops) {
-            map[cpus][ops] = benchmark(roofline, cpus, ops, 2 * size * ops, 16 * size);
+            map[cpus][ops] = benchmark(roofline, *rooflineLoops[ops], size / 8,
+                                       cpus, ops, 2 * size * ops, 16 * size);
         }
     }
 
@@ -0,0 +1,12 @@
+QT += core
+QT -= gui
+
+TARGET = dispatch-analyze
+CONFIG += console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+SOURCES += main.cpp
+
+include(../common.pri)
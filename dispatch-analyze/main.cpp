@@ -0,0 +1,296 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <QVector>
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+/*
+ * Load imbalance report of the dispatch:entry / dispatch:exit events, from
+ * the Chrome JSON of the ring buffer tracer, from the text output of
+ * babeltrace2, or from a CTF trace directory read with babeltrace2.
+ */
+
+struct Chunk {
+    int thread;
+    qint64 start;       // ns
+    qint64 stop;
+    int begin;
+    int end;
+};
+
+struct Region {
+    qint64 start;
+    qint64 stop;
+    QVector<Chunk> chunks;
+};
+
+struct ThreadStats {
+    int chunks;
+    qint64 items;
+    qint64 busy;
+    qint64 first;
+    qint64 last;
+    int steals;
+};
+
+bool loadChrome(const QByteArray &data, QVector<Chunk> &chunks)
+{
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+    if (doc.isNull()) {
+        qDebug() << "invalid JSON:" << error.errorString();
+        return false;
+    }
+    QMap<int, Chunk> open;
+    for (const QJsonValue &value : doc.object().value("traceEvents").toArray()) {
+        QJsonObject event = value.toObject();
+        QString ph = event.value("ph").toString();
+        int tid = event.value("tid").toInt();
+        qint64 ts = event.value("ts").toDouble() * 1000;
+        if (ph == "B" && event.value("name").toString() == "chunk") {
+            QJsonObject args = event.value("args").toObject();
+            Chunk chunk = { tid, ts, 0, args.value("begin").toInt(), args.value("end").toInt() };
+            open[tid] = chunk;
+        } else if (ph == "E" && open.contains(tid)) {
+            Chunk chunk = open.take(tid);
+            chunk.stop = ts;
+            chunks.append(chunk);
+        }
+    }
+    return true;
+}
+
+/*
+ * Default babeltrace2 text output, for instance
+ * [13:45:12.123456789] (+0.000001234) host dispatch:entry: { cpu_id = 2 }, { vtid = 1234 },
+ * { begin = 0, end = 39, color = 1 }
+ * Threads are identified by the vtid context if the session added it
+ * (lttng add-context -u -t vtid), by the cpu otherwise.
+ */
+bool loadBabeltrace(QTextStream &stream, QVector<Chunk> &chunks)
+{
+    QRegularExpression line_re("^\\[(\\d+):(\\d+):(\\d+)\\.(\\d+)\\].*dispatch:(entry|exit):(.*)$");
+    QRegularExpression field_re("(\\w+) = (-?\\d+)");
+    QMap<int, Chunk> open;
+    while (!stream.atEnd()) {
+        QRegularExpressionMatch m = line_re.match(stream.readLine());
+        if (!m.hasMatch())
+            continue;
+        QString frac = m.captured(4).leftJustified(9, '0').left(9);
+        qint64 ts = ((m.captured(1).toLongLong() * 60 + m.captured(2).toLongLong()) * 60 +
+                     m.captured(3).toLongLong()) * 1000000000LL + frac.toLongLong();
+        QMap<QString, int> fields;
+        QRegularExpressionMatchIterator it = field_re.globalMatch(m.captured(6));
+        while (it.hasNext()) {
+            QRegularExpressionMatch f = it.next();
+            fields[f.captured(1)] = f.captured(2).toInt();
+        }
+        int tid = fields.contains("vtid") ? fields["vtid"] : fields.value("cpu_id");
+        if (m.captured(5) == "entry") {
+            Chunk chunk = { tid, ts, 0, fields.value("begin"), fields.value("end") };
+            open[tid] = chunk;
+        } else if (open.contains(tid)) {
+            Chunk chunk = open.take(tid);
+            chunk.stop = ts;
+            chunks.append(chunk);
+        }
+    }
+    return true;
+}
+
+bool loadTrace(const QString &path, QVector<Chunk> &chunks)
+{
+    if (QFileInfo(path).isDir()) {
+        QProcess babeltrace;
+        babeltrace.start("babeltrace2", QStringList() << path);
+        if (!babeltrace.waitForFinished(-1) || babeltrace.exitCode() != 0) {
+            qDebug() << "babeltrace2 failed on" << path;
+            return false;
+        }
+        QByteArray text = babeltrace.readAllStandardOutput();
+        QTextStream stream(&text);
+        return loadBabeltrace(stream, chunks);
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "cannot open" << path;
+        return false;
+    }
+    QByteArray data = file.readAll();
+    if (data.trimmed().startsWith('{'))
+        return loadChrome(data, chunks);
+    QTextStream stream(&data);
+    return loadBabeltrace(stream, chunks);
+}
+
+/*
+ * The program runs several parallel loops one after the other, a region
+ * ends when no chunk is running for more than gap.
+ */
+QVector<Region> splitRegions(QVector<Chunk> chunks, qint64 gap)
+{
+    QVector<Region> regions;
+    sort(chunks.begin(), chunks.end(), [](const Chunk &a, const Chunk &b) {
+        return a.start < b.start;
+    });
+    for (const Chunk &chunk : chunks) {
+        if (regions.isEmpty() || chunk.start > regions.last().stop + gap) {
+            Region region = { chunk.start, chunk.stop, QVector<Chunk>() };
+            regions.append(region);
+        }
+        Region &region = regions.last();
+        region.stop = max(region.stop, chunk.stop);
+        region.chunks.append(chunk);
+    }
+    return regions;
+}
+
+// power of two buckets, bucket k counts values in [2^k, 2^(k+1))
+void printHistogram(const QString &title, const QVector<qint64> &values)
+{
+    QMap<int, int> buckets;
+    for (qint64 v : values) {
+        int k = 0;
+        while ((2LL << k) <= v)
+            k++;
+        buckets[k]++;
+    }
+    qDebug().noquote() << title;
+    for (int k : buckets.keys()) {
+        qDebug().noquote() << QString("  [%1, %2) %3 %4")
+                              .arg(k == 0 ? 0 : 1LL << k, 10)
+                              .arg(2LL << k, 10)
+                              .arg(buckets[k], 6)
+                              .arg(QString(min(buckets[k], 60), '#'));
+    }
+}
+
+/*
+ * Per thread busy and idle time over the region, idle being the time of
+ * the region not spent in a chunk. A steal is a chunk that does not start
+ * where the previous chunk of the thread ended. The critical path of a
+ * parallel loop is the thread that ends last: the region is as long as its
+ * idle time before its first chunk plus its own chunks and gaps.
+ */
+void report(int index, const Region &region)
+{
+    QMap<int, ThreadStats> threads;
+    QVector<qint64> sizes;
+    QVector<qint64> durations;
+    QMap<int, int> previous_end;
+    const Chunk *longest = nullptr;
+    for (const Chunk &chunk : region.chunks) {
+        ThreadStats &t = threads[chunk.thread];
+        if (t.chunks == 0) {
+            t.first = chunk.start;
+        } else if (previous_end[chunk.thread] != chunk.begin) {
+            t.steals++;
+        }
+        previous_end[chunk.thread] = chunk.end;
+        t.chunks++;
+        t.items += chunk.end - chunk.begin;
+        t.busy += chunk.stop - chunk.start;
+        t.last = max(t.last, chunk.stop);
+        sizes.append(chunk.end - chunk.begin);
+        durations.append(chunk.stop - chunk.start);
+        if (longest == nullptr || chunk.stop - chunk.start > longest->stop - longest->start)
+            longest = &chunk;
+    }
+
+    qint64 span = region.stop - region.start;
+    qint64 total_busy = 0;
+    qint64 max_busy = 0;
+    int critical = threads.firstKey();
+    int steals = 0;
+    for (int tid : threads.keys()) {
+        const ThreadStats &t = threads[tid];
+        total_busy += t.busy;
+        max_busy = max(max_busy, t.busy);
+        steals += t.steals;
+        if (t.last > threads[critical].last)
+            critical = tid;
+    }
+    double mean_busy = (double) total_busy / threads.size();
+
+    qDebug().noquote() << QString("region %1: %2 threads, %3 chunks, span %4 ms, efficiency %5%, "
+                                  "imbalance %6%, steals %7")
+                          .arg(index)
+                          .arg(threads.size())
+                          .arg(region.chunks.size())
+                          .arg(span / 1e6, 0, 'f', 3)
+                          .arg(100.0 * total_busy / ((double) span * threads.size()), 0, 'f', 1)
+                          .arg(100.0 * (max_busy - mean_busy) / max_busy, 0, 'f', 1)
+                          .arg(steals);
+    const ThreadStats &c = threads[critical];
+    qDebug().noquote() << QString("  critical path: thread %1 starts after %2 ms, busy %3 ms, "
+                                  "idle %4 ms, longest chunk [%5, %6) %7 ms on thread %8")
+                          .arg(critical)
+                          .arg((c.first - region.start) / 1e6, 0, 'f', 3)
+                          .arg(c.busy / 1e6, 0, 'f', 3)
+                          .arg((c.last - c.first - c.busy) / 1e6, 0, 'f', 3)
+                          .arg(longest->begin)
+                          .arg(longest->end)
+                          .arg((longest->stop - longest->start) / 1e6, 0, 'f', 3)
+                          .arg(longest->thread);
+    printHistogram("  chunk size (items)", sizes);
+    printHistogram("  chunk duration (ns)", durations);
+
+    for (int tid : threads.keys()) {
+        const ThreadStats &t = threads[tid];
+        cout << QString("%1,%2,%3,%4,%5,%6,%7")
+                .arg(index)
+                .arg(tid)
+                .arg(t.chunks)
+                .arg(t.items)
+                .arg(t.busy)
+                .arg(span - t.busy)
+                .arg(t.steals)
+                .toStdString() << endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.setApplicationDescription("load imbalance of dispatch traces");
+    parser.addPositionalArgument("trace",
+            "Chrome JSON of the ring tracer, babeltrace2 text output or CTF directory");
+
+    QCommandLineOption gapOption("gap", "idle time separating two regions (us)", "gap", "1000");
+    parser.addOption(gapOption);
+
+    parser.process(app);
+    if (parser.positionalArguments().size() != 1) {
+        parser.showHelp(1);
+    }
+
+    QVector<Chunk> chunks;
+    if (!loadTrace(parser.positionalArguments().first(), chunks))
+        return 1;
+    if (chunks.isEmpty()) {
+        qDebug() << "no dispatch:entry/exit events";
+        return 1;
+    }
+
+    QVector<Region> regions = splitRegions(chunks, parser.value(gapOption).toLongLong() * 1000);
+    cout << "region,thread,chunks,items,busy_ns,idle_ns,steals" << endl;
+    for (int i = 0; i < regions.size(); i++) {
+        report(i, regions[i]);
+    }
+    return 0;
+}
@@ -12,6 +12,7 @@
 #include <stdlib.h>
 #include <time.h>
 #include <math.h>
+#include <tmmintrin.h>
 
 #include "color.h"
 
@@ -84,3 +85,140 @@ void dump_palette(struct palette *palette)
 		printf("%d %d %d\n", palette->colors[i].r, palette->colors[i].g, palette->colors[i].b);
 	}
 }
+
+struct planes *make_planes(int width, int height)
+{
+	int area = width * height;
+	struct planes *planes;
+
+	if (area <= 0)
+		return NULL;
+	planes = (struct planes *) malloc(sizeof(struct planes));
+	if (planes == NULL)
+		return NULL;
+	// one allocation, the planes follow each other
+	planes->r = (unsigned char *) malloc(3 * area);
+	if (planes->r == NULL) {
+		free(planes);
+		return NULL;
+	}
+	planes->g = planes->r + area;
+	planes->b = planes->g + area;
+	planes->width = width;
+	planes->height = height;
+	return planes;
+}
+
+void free_planes(struct planes *planes)
+{
+	if (planes == NULL)
+		return;
+	free(planes->r);
+	free(planes);
+}
+
+/*
+ * 16 pixels are 48 bytes, 3 registers. The byte of channel c of pixel p is
+ * at 3 * p + c: each plane register is the OR of one shuffle of each of the
+ * 3 registers, and the other way around. Masks bytes 0x80 select zero.
+ */
+__attribute__((target("ssse3")))
+static int rgb_to_planes_ssse3(const unsigned char *src, unsigned char *r,
+		unsigned char *g, unsigned char *b, int area)
+{
+	unsigned char masks[3][3][16];
+	unsigned char *dst[3] = { r, g, b };
+	__m128i m[3][3];
+	int c, k, j, i;
+
+	// byte j of plane c from register k
+	for (c = 0; c < 3; c++) {
+		for (k = 0; k < 3; k++) {
+			for (j = 0; j < 16; j++) {
+				int pos = 3 * j + c - 16 * k;
+				masks[c][k][j] = (pos >= 0 && pos < 16) ? pos : 0x80;
+			}
+		}
+	}
+	for (c = 0; c < 3; c++)
+		for (k = 0; k < 3; k++)
+			m[c][k] = _mm_loadu_si128((__m128i *) masks[c][k]);
+
+	for (i = 0; i + 16 <= area; i += 16) {
+		__m128i in[3];
+		for (k = 0; k < 3; k++)
+			in[k] = _mm_loadu_si128((__m128i *) (src + 3 * i + 16 * k));
+		for (c = 0; c < 3; c++) {
+			__m128i v = _mm_or_si128(_mm_or_si128(
+					_mm_shuffle_epi8(in[0], m[c][0]),
+					_mm_shuffle_epi8(in[1], m[c][1])),
+					_mm_shuffle_epi8(in[2], m[c][2]));
+			_mm_storeu_si128((__m128i *) (dst[c] + i), v);
+		}
+	}
+	return i;
+}
+
+__attribute__((target("ssse3")))
+static int planes_to_rgb_ssse3(const unsigned char *r, const unsigned char *g,
+		const unsigned char *b, unsigned char *dst, int area)
+{
+	unsigned char masks[3][3][16];
+	__m128i m[3][3];
+	int c, k, j, i;
+
+	// byte j of register k from the plane of its channel
+	for (c = 0; c < 3; c++) {
+		for (k = 0; k < 3; k++) {
+			for (j = 0; j < 16; j++)
+				masks[c][k][j] = ((16 * k + j) % 3 == c) ? (16 * k + j) / 3 : 0x80;
+		}
+	}
+	for (c = 0; c < 3; c++)
+		for (k = 0; k < 3; k++)
+			m[c][k] = _mm_loadu_si128((__m128i *) masks[c][k]);
+
+	for (i = 0; i + 16 <= area; i += 16) {
+		__m128i vr = _mm_loadu_si128((__m128i *) (r + i));
+		__m128i vg = _mm_loadu_si128((__m128i *) (g + i));
+		__m128i vb = _mm_loadu_si128((__m128i *) (b + i));
+		for (k = 0; k < 3; k++) {
+			__m128i v = _mm_or_si128(_mm_or_si128(
+					_mm_shuffle_epi8(vr, m[0][k]),
+					_mm_shuffle_epi8(vg, m[1][k])),
+					_mm_shuffle_epi8(vb, m[2][k]));
+			_mm_storeu_si128((__m128i *) (dst + 3 * i + 16 * k), v);
+		}
+	}
+	return i;
+}
+
+void planes_to_rgb(struct planes *planes, struct rgb *image)
+{
+	int i = 0;
+	int area = planes->width * planes->height;
+
+	if (__builtin_cpu_supports("ssse3"))
+		i = planes_to_rgb_ssse3(planes->r, planes->g, planes->b,
+				(unsigned char *) image, area);
+	for (; i < area; i++) {
+		image[i].r = planes->r[i];
+		image[i].g = planes->g[i];
+		image[i].b = planes->b[i];
+	}
+}
+
+void rgb_to_planes(struct rgb *image, struct planes *planes)
+{
+	int i = 0;
+	int area = planes->width * planes->height;
+
+	if (__builtin_cpu_supports("ssse3"))
+		i = rgb_to_planes_ssse3((unsigned char *) image, planes->r, planes->g,
+				planes->b, area);
+	for (; i < area; i++) {
+		planes->r[i] = image[i].r;
+		planes->g[i] = image[i].g;
+		planes->b[i] = image[i].b;
+	}
+}
@@ -19,6 +19,17 @@ struct palette {
 	int len;
 };
 
+/*
+ * planar image, one plane of width * height bytes per channel
+ */
+struct planes {
+	unsigned char *r;
+	unsigned char *g;
+	unsigned char *b;
+	int width;
+	int height;
+};
+
 extern const struct rgb white;
 extern const struct rgb black;
 
@@ -26,6 +37,10 @@ void random_color(struct rgb *color);
 struct palette *init_palette(int num);
 void free_palette(struct palette *palette);
 void dump_palette(struct palette *palette);
+struct planes *make_planes(int width, int height);
+void free_planes(struct planes *planes);
+void planes_to_rgb(struct planes *planes, struct rgb *image);
+void rgb_to_planes(struct rgb *image, struct planes *planes);
 
 
 #endif /* COLOR_H_ */
@@ -14,8 +14,48 @@
 #include <math.h>
 
 #include "dragon.h"
+#include "dragon_trace.h"
 #include "color.h"
 
+double phase_elapsed[PHASE_COUNT];
+static double phase_start[PHASE_COUNT];
+const char *phase_names[PHASE_COUNT] = { "limits", "clear", "draw", "render" };
+
+double seconds(struct timespec *t)
+{
+	return t->tv_sec + 1.0E-9 * t->tv_nsec;
+}
+
+double now_seconds(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &t);
+	return seconds(&t);
+}
+
+void phase_reset(void)
+{
+	int i;
+	for (i = 0; i < PHASE_COUNT; i++)
+		phase_elapsed[i] = 0;
+}
+
+/*
+ * Phases are marked by a single thread at a time: the caller of the
+ * backend, or the worker with id 0 right after a barrier.
+ */
+void phase_begin(enum dragon_phase phase)
+{
+	tracepoint(dragonizer, phase_begin, phase);
+	phase_start[phase] = now_seconds();
+}
+
+void phase_end(enum dragon_phase phase)
+{
+	phase_elapsed[phase] += now_seconds() - phase_start[phase];
+	tracepoint(dragonizer, phase_end, phase);
+}
+
 xy_t compute_position(int64_t i)
 {
 	xy_t position;
@@ -66,6 +106,7 @@ int dragon_draw_raw(uint64_t start, uint64_t end, char *dragon, int width, int h
 	if (end == start)
 		return 0;
 
+	tracepoint(dragonizer, chunk_entry, start, end, id);
 	xy_t position;
 	xy_t orientation;
 	int i, j;
@@ -83,6 +124,7 @@ int dragon_draw_raw(uint64_t start, uint64_t end, char *dragon, int width, int h
 		int index = i * width + j;
 		if (index < 0 || index > area) {
 			printf("index is out of range\n");
+			tracepoint(dragonizer, chunk_exit);
 			return -1;
 		}
 		dragon[index] = id;
@@ -93,6 +135,7 @@ int dragon_draw_raw(uint64_t start, uint64_t end, char *dragon, int width, int h
 		else
 			rotate_right(&orientation);
 	}
+	tracepoint(dragonizer, chunk_exit);
 	return 0;
 }
 
@@ -134,63 +177,134 @@ void dump_canvas_rgb(struct rgb *canvas, int width, int height)
 void scale_dragon(int start, int end, struct rgb *image, int image_width, int image_height,
         char *dragon, int dragon_width, int dragon_height, struct palette *palette)
 {
-    int i, j, x, y;
+    scale_dragon_view(start, end, image, image_width, image_height, dragon, dragon_width,
+            0, 0, dragon_width, dragon_height, palette);
+}
+
+/*
+ * average color of the cell [i1, i2) x [j1, j2) of the dragon, the pixels
+ * not drawn are white
+ */
+static inline struct rgb average_cell(char *dragon, int stride, int i1, int i2,
+        int j1, int j2, struct rgb *colors)
+{
+    int i, j;
+    int red = 0;
+    int green = 0;
+    int blue = 0;
+    int cnt = 0;
+    struct rgb c = white;
+
+    for (i = i1; i < i2; i++) {
+        for (j = j1; j < j2; j++) {
+            int id = dragon[i * stride + j];
+            if (id >= 0) {
+                red     += colors[id].r;
+                green   += colors[id].g;
+                blue    += colors[id].b;
+            } else {
+                red     += 255;
+                green   += 255;
+                blue    += 255;
+            }
+            cnt++;
+        }
+    }
+    if (cnt > 0) {
+        c.r = (unsigned char) (red   / cnt);
+        c.g = (unsigned char) (green / cnt);
+        c.b = (unsigned char) (blue  / cnt);
+    }
+    return c;
+}
+
+/*
+ * scale the rectangle (view_x, view_y, view_width, view_height) of the
+ * dragon into the image. stride is the width of the whole dragon.
+ */
+void scale_dragon_view(int start, int end, struct rgb *image, int image_width, int image_height,
+        char *dragon, int stride, int view_x, int view_y, int view_width, int view_height,
+        struct palette *palette)
+{
+    int x, y;
+    int scale_x = view_width / image_width + 1;
+    int scale_y = view_height / image_height + 1;
+    int scale = (scale_x > scale_y ? scale_x : scale_y);
+    int deltaJ = (scale * image_width - view_width) / 2;
+    int deltaI = (scale * image_height - view_height) / 2;
+
+    dragon += view_y * stride + view_x;
+    for (y = start; y < end; y++) {
+        int i1 = y * scale - deltaI;
+        int i2 = i1 + scale;
+        if (i1 < 0) i1 = 0;
+        if (i2 > view_height) i2 = view_height;
+        for (x = 0; x < image_width; x++) {
+            int j1 = x * scale - deltaJ, j2 = j1 + scale;
+            if (j1 < 0) j1 = 0;
+            if (j2 > view_width) j2 = view_width;
+            image[y * image_width + x] = average_cell(dragon, stride, i1, i2, j1, j2,
+                    palette->colors);
+        }
+    }
+}
+
+/*
+ * same as scale_dragon(), the channels of the image are written to
+ * separate planes
+ */
+void scale_dragon_planar(int start, int end, struct planes *image,
+        char *dragon, int dragon_width, int dragon_height, struct palette *palette)
+{
+    int x, y;
+    int image_width = image->width;
+    int image_height = image->height;
     int scale_x = dragon_width / image_width + 1;
     int scale_y = dragon_height / image_height + 1;
     int scale = (scale_x > scale_y ? scale_x : scale_y);
     int deltaJ = (scale * image_width - dragon_width) / 2;
     int deltaI = (scale * image_height - dragon_height) / 2;
-    struct rgb *colors = palette->colors;
 
     for (y = start; y < end; y++) {
         int i1 = y * scale - deltaI;
         int i2 = i1 + scale;
         if (i1 < 0) i1 = 0;
         if (i2 > dragon_height) i2 = dragon_height;
+        unsigned char *r = image->r + y * image_width;
+        unsigned char *g = image->g + y * image_width;
+        unsigned char *b = image->b + y * image_width;
         for (x = 0; x < image_width; x++) {
             int j1 = x * scale - deltaJ, j2 = j1 + scale;
-            int red = 0;
-            int green = 0;
-            int blue = 0;
-            int cnt = 0;
             if (j1 < 0) j1 = 0;
             if (j2 > dragon_width) j2 = dragon_width;
-            for (i = i1; i < i2; i++) {
-                for (j = j1; j < j2; j++) {
-                    int id = dragon[i * dragon_width + j];
-                    if (id >= 0) {
-                        red     += colors[id].r;
-                        green   += colors[id].g;
-                        blue    += colors[id].b;
-                    } else {
-                        red     += 255;
-                        green   += 255;
-                        blue    += 255;
-                    }
-                    cnt++;
-                }
-            }
-            int index = y * image_width + x;
-            if (cnt == 0) {
-                image[index] = white;
-            } else {
-                image[index].r = (unsigned char) (red   / cnt);
-                image[index].g = (unsigned char) (green / cnt);
-                image[index].b = (unsigned char) (blue  / cnt);
-            }
+            struct rgb c = average_cell(dragon, dragon_width, i1, i2, j1, j2, palette->colors);
+            r[x] = c.r;
+            g[x] = c.g;
+            b[x] = c.b;
         }
     }
 }
 
 int dragon_draw_serial(char **canvas, struct rgb *image, int width, int height, uint64_t size, int nb_colors)
 {
-	int ret = 0;
-	char *dragon = NULL;
-	struct palette *palette = NULL;
 	limits_t limits;
 
+	phase_begin(PHASE_LIMITS);
 	if (dragon_limits_serial(&limits, size, 0) < 0)
-		goto err;
+		return -1;
+	phase_end(PHASE_LIMITS);
+
+	return dragon_draw_limits_serial(canvas, image, width, height, size, nb_colors, &limits);
+}
+
+/* same as dragon_draw_serial(), with the limits already known */
+int dragon_draw_limits_serial(char **canvas, struct rgb *image, int width, int height, uint64_t size,
+		int nb_colors, const limits_t *known)
+{
+	int ret = 0;
+	char *dragon = NULL;
+	struct palette *palette = NULL;
+	limits_t limits = *known;
 
 	int dragon_width = limits.maximums.x - limits.minimums.x;
 	int dragon_height = limits.maximums.y - limits.minimums.y;
@@ -206,17 +320,23 @@ int dragon_draw_serial(char **canvas, struct rgb *image, int width, int height,
 		goto err;
 
 	// clear dragon
+	phase_begin(PHASE_CLEAR);
 	init_canvas(0, area, dragon, -1);
+	phase_end(PHASE_CLEAR);
 
 	// Draw dragon
+	phase_begin(PHASE_DRAW);
 	for (m = 0; m < nb_colors; m++) {
 		uint64_t start = m * size / nb_colors;
 		uint64_t end = (m + 1) * size / nb_colors;
 		dragon_draw_raw(start, end, dragon, dragon_width, dragon_height, limits, m);
 	}
+	phase_end(PHASE_DRAW);
 
 	// Scale dragon to fit the final image
+	phase_begin(PHASE_RENDER);
 	scale_dragon(0, height, image, width, height, dragon, dragon_width, dragon_height, palette);
+	phase_end(PHASE_RENDER);
 
 done:
 	free_palette(palette);
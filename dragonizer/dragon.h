@@ -12,6 +12,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <time.h>
 #include "color.h"
 
 /**
@@ -46,6 +47,21 @@ typedef struct morceau_ {
 	limits_t	limits;
 } piece_t;
 
+/*
+ * Phases of the drawing, timed by every backend. The elapsed time of the
+ * last draw is available in phase_elapsed[] (seconds).
+ */
+enum dragon_phase {
+	PHASE_LIMITS,
+	PHASE_CLEAR,
+	PHASE_DRAW,
+	PHASE_RENDER,
+	PHASE_COUNT,
+};
+
+extern double phase_elapsed[PHASE_COUNT];
+extern const char *phase_names[PHASE_COUNT];
+
 struct draw_data {
 	int id;
 	int *tid;
@@ -86,6 +102,8 @@ void limits_invert(limits_t *limites);
 xy_t compute_position(int64_t i);
 xy_t compute_orientation(int64_t i);
 int dragon_draw_serial(char **dragon, struct rgb *image, int width, int height, uint64_t size, __attribute__((unused)) int nb_thread);
+int dragon_draw_limits_serial(char **dragon, struct rgb *image, int width, int height, uint64_t size,
+		int nb_colors, const limits_t *limits);
 void dump_canvas(char *canvas, int width, int height);
 void dump_canvas_rgb(struct rgb *canvas, int width, int height);
 int write_img(struct rgb *image, char *file, int width, int height);
@@ -94,6 +112,16 @@ int cmp_canvas(char *exp, char *act, int width, int height, int verbose);
 void init_canvas(int start, int end, char *canvas, char value);
 void scale_dragon(int start, int end, struct rgb *image, int image_width, int image_height,
         char *dragon, int dragon_width, int dragon_height, struct palette *palette);
+void scale_dragon_view(int start, int end, struct rgb *image, int image_width, int image_height,
+        char *dragon, int stride, int view_x, int view_y, int view_width, int view_height,
+        struct palette *palette);
+void scale_dragon_planar(int start, int end, struct planes *image,
+        char *dragon, int dragon_width, int dragon_height, struct palette *palette);
 int dragon_draw_raw(uint64_t start, uint64_t end, char *dragon, int width, int height, limits_t limits, char id);
+double seconds(struct timespec *t);
+double now_seconds(void);
+void phase_reset(void);
+void phase_begin(enum dragon_phase phase);
+void phase_end(enum dragon_phase phase);
 
 #endif /* DRAGON_H_ */
@@ -12,6 +12,7 @@
 #include <string.h>
 
 #include "dragon.h"
+#include "dragon_trace.h"
 #include "color.h"
 #include "dragon_pthread.h"
 
@@ -28,6 +29,14 @@ void printf_threadsafe(char *format, ...)
 	va_end(ap);
 }
 
+/* wait for the other workers at the end of phase */
+static void worker_barrier(struct draw_data *d, __attribute__((unused)) enum dragon_phase phase)
+{
+	tracepoint(dragonizer, barrier_entry, d->id, phase);
+	pthread_barrier_wait(d->barrier);
+	tracepoint(dragonizer, barrier_exit, d->id, phase);
+}
+
 void *dragon_draw_worker(void *data)
 {
 	struct draw_data d;
@@ -47,7 +56,11 @@ void *dragon_draw_worker(void *data)
 	init_canvas(y1, y2, d.dragon, -1);
 
 	// barrier
-	pthread_barrier_wait(d.barrier);
+	worker_barrier(&d, PHASE_CLEAR);
+	if (d.id == 0) {
+		phase_end(PHASE_CLEAR);
+		phase_begin(PHASE_DRAW);
+	}
 
 	n1 = d.id * d.size / d.nb_thread;
 	n2 = (d.id + 1) * d.size / d.nb_thread;
@@ -56,7 +69,11 @@ void *dragon_draw_worker(void *data)
 	dragon_draw_raw(n1, n2, d.dragon, d.dragon_width, d.dragon_height, d.limits, d.id);
 
 	// barrier
-	pthread_barrier_wait(d.barrier);
+	worker_barrier(&d, PHASE_DRAW);
+	if (d.id == 0) {
+		phase_end(PHASE_DRAW);
+		phase_begin(PHASE_RENDER);
+	}
 
 	/* 3. Effectuer le rendu final */
 	y1 = d.id * d.image_height / d.nb_thread;
@@ -65,16 +82,33 @@ void *dragon_draw_worker(void *data)
 	        d.dragon, d.dragon_width, d.dragon_height, d.palette);
 
 	// barrier
-	pthread_barrier_wait(d.barrier);
+	worker_barrier(&d, PHASE_RENDER);
+	if (d.id == 0)
+		phase_end(PHASE_RENDER);
 
 	return NULL;
 }
 
 int dragon_draw_pthread(char **canvas, struct rgb *image, int width, int height, uint64_t size, int nb_thread)
+{
+	limits_t limits;
+
+	/* 1. Calculer les limites du dragon */
+	phase_begin(PHASE_LIMITS);
+	if (dragon_limits_pthread(&limits, size, nb_thread) < 0)
+		return -1;
+	phase_end(PHASE_LIMITS);
+
+	return dragon_draw_limits_pthread(canvas, image, width, height, size, nb_thread, &limits);
+}
+
+/* Comme dragon_draw_pthread(), les limites étant déjà connues */
+int dragon_draw_limits_pthread(char **canvas, struct rgb *image, int width, int height, uint64_t size,
+		int nb_thread, const limits_t *known)
 {
 	pthread_t *threads = NULL;
 	pthread_barrier_t barrier;
-	limits_t limits;
+	limits_t limits = *known;
 	struct draw_data info;
 	char *dragon = NULL;
 	int i;
@@ -94,10 +128,6 @@ int dragon_draw_pthread(char **canvas, struct rgb *image, int width, int height,
 		goto err;
 	}
 
-	/* 1. Calculer les limites du dragon */
-	if (dragon_limits_pthread(&limits, size, nb_thread) < 0)
-		goto err;
-
 	info.dragon_width = limits.maximums.x - limits.minimums.x;
 	info.dragon_height = limits.maximums.y - limits.minimums.y;
 
@@ -134,6 +164,7 @@ int dragon_draw_pthread(char **canvas, struct rgb *image, int width, int height,
 	info.image = image;
 
 	/* 2. Lancement du calcul parallèle principal avec draw_dragon_worker */
+	phase_begin(PHASE_CLEAR);
 	for (i = 0; i < nb_thread; i++) {
 		data[i] = info;
 		data[i].id = i;
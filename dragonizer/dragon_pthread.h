@@ -11,6 +11,8 @@
 #include "dragon.h"
 
 int dragon_draw_pthread(char **canvas, struct rgb *image, int width, int height, uint64_t size, int nb_thread);
+int dragon_draw_limits_pthread(char **canvas, struct rgb *image, int width, int height, uint64_t size,
+		int nb_thread, const limits_t *limits);
 int dragon_limits_pthread(limits_t *lim, uint64_t size, int nb_thread);
 
 #endif /* DRAGON_PTHREAD_H_ */
@@ -0,0 +1,272 @@
+/*
+ * dragon_server.c
+ *
+ * Canvas cache and UNIX socket plumbing of the dragonizer service. Requests
+ * are served one at a time, the parallelism is in the drawing itself, so
+ * the cache needs no locking.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "dragon.h"
+#include "dragon_server.h"
+
+struct canvas_cache *canvas_cache_new(int len)
+{
+	struct canvas_cache *cache;
+
+	if (len <= 0)
+		return NULL;
+	cache = (struct canvas_cache *) calloc(1, sizeof(struct canvas_cache));
+	if (cache == NULL)
+		return NULL;
+	cache->entries = (struct canvas_entry *) calloc(len, sizeof(struct canvas_entry));
+	if (cache->entries == NULL) {
+		free(cache);
+		return NULL;
+	}
+	cache->len = len;
+	return cache;
+}
+
+void canvas_cache_free(struct canvas_cache *cache)
+{
+	int i;
+
+	if (cache == NULL)
+		return;
+	for (i = 0; i < cache->len; i++)
+		FREE(cache->entries[i].dragon);
+	free(cache->entries);
+	free(cache);
+}
+
+struct canvas_entry *canvas_cache_lookup(struct canvas_cache *cache, uint64_t size, int nb_colors,
+		const char *lib)
+{
+	int i;
+
+	for (i = 0; i < cache->len; i++) {
+		struct canvas_entry *e = &cache->entries[i];
+		if (e->dragon != NULL && e->size == size && e->nb_colors == nb_colors &&
+				strcmp(e->lib, lib) == 0) {
+			e->last_use = ++cache->clock;
+			return e;
+		}
+	}
+	return NULL;
+}
+
+/* limits only depend on the size, any canvas of that size has them */
+int canvas_cache_limits(struct canvas_cache *cache, uint64_t size, limits_t *limits)
+{
+	int i;
+
+	for (i = 0; i < cache->len; i++) {
+		struct canvas_entry *e = &cache->entries[i];
+		if (e->dragon != NULL && e->size == size) {
+			*limits = e->limits;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/*
+ * The cache takes ownership of dragon. The least recently used entry is
+ * evicted when the cache is full.
+ */
+struct canvas_entry *canvas_cache_insert(struct canvas_cache *cache, uint64_t size, int nb_colors,
+		const char *lib, char *dragon, limits_t limits)
+{
+	struct canvas_entry *victim = &cache->entries[0];
+	int i;
+
+	for (i = 0; i < cache->len; i++) {
+		struct canvas_entry *e = &cache->entries[i];
+		if (e->dragon == NULL) {
+			victim = e;
+			break;
+		}
+		if (e->last_use < victim->last_use)
+			victim = e;
+	}
+	FREE(victim->dragon);
+	victim->size = size;
+	victim->nb_colors = nb_colors;
+	strncpy(victim->lib, lib, REQUEST_LIB_LEN - 1);
+	victim->lib[REQUEST_LIB_LEN - 1] = '\0';
+	victim->dragon = dragon;
+	victim->limits = limits;
+	victim->last_use = ++cache->clock;
+	return victim;
+}
+
+static int socket_addr(const char *path, struct sockaddr_un *addr)
+{
+	memset(addr, 0, sizeof(struct sockaddr_un));
+	addr->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr->sun_path)) {
+		printf("socket path too long %s\n", path);
+		return -1;
+	}
+	strcpy(addr->sun_path, path);
+	return 0;
+}
+
+int server_listen(const char *path)
+{
+	struct sockaddr_un addr;
+	int sock;
+
+	if (socket_addr(path, &addr) < 0)
+		return -1;
+	if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		perror("socket");
+		return -1;
+	}
+	unlink(path);
+	if (bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		perror("bind");
+		goto err;
+	}
+	if (listen(sock, 16) < 0) {
+		perror("listen");
+		goto err;
+	}
+	return sock;
+err:
+	close(sock);
+	return -1;
+}
+
+int client_connect(const char *path)
+{
+	struct sockaddr_un addr;
+	int sock;
+
+	if (socket_addr(path, &addr) < 0)
+		return -1;
+	if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		perror("socket");
+		return -1;
+	}
+	if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		perror("connect");
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+/*
+ * Create an anonymous shared memory file for the image and map it.
+ * Returns the file descriptor.
+ */
+int image_memfd(int width, int height, struct rgb **image)
+{
+	size_t len = sizeof(struct rgb) * width * height;
+	int fd;
+	void *addr;
+
+	if ((fd = memfd_create("dragon", MFD_CLOEXEC)) < 0) {
+		perror("memfd_create");
+		return -1;
+	}
+	if (ftruncate(fd, len) < 0) {
+		perror("ftruncate");
+		goto err;
+	}
+	addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		perror("mmap");
+		goto err;
+	}
+	*image = (struct rgb *) addr;
+	return fd;
+err:
+	close(fd);
+	return -1;
+}
+
+/* send the reply, with fd attached when fd >= 0 */
+int send_reply(int sock, struct dragon_reply *reply, int fd)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	char control[CMSG_SPACE(sizeof(int))];
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = reply;
+	iov.iov_len = sizeof(struct dragon_reply);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	if (fd >= 0) {
+		struct cmsghdr *cmsg;
+		memset(control, 0, sizeof(control));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	}
+
+	if (sendmsg(sock, &msg, MSG_NOSIGNAL) != sizeof(struct dragon_reply)) {
+		perror("sendmsg");
+		return -1;
+	}
+	return 0;
+}
+
+/* receive the reply, fd is -1 if no image is attached */
+int recv_reply(int sock, struct dragon_reply *reply, int *fd)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char control[CMSG_SPACE(sizeof(int))];
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = reply;
+	iov.iov_len = sizeof(struct dragon_reply);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	*fd = -1;
+	if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != sizeof(struct dragon_reply)) {
+		perror("recvmsg");
+		return -1;
+	}
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+		memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+	return 0;
+}
+
+int read_full(int fd, void *buf, size_t len)
+{
+	char *p = (char *) buf;
+
+	while (len > 0) {
+		ssize_t r = read(fd, p, len);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return -1;
+		p += r;
+		len -= r;
+	}
+	return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * dragon_server.h
+ *
+ * Long-running dragonizer service: canvas cache and UNIX socket protocol.
+ */
+
+#ifndef DRAGON_SERVER_H_
+#define DRAGON_SERVER_H_
+
+#include "dragon.h"
+
+#define DEFAULT_SOCKET_PATH "/tmp/dragonizer.sock"
+#define DEFAULT_CACHE_LEN 8
+#define REQUEST_LIB_LEN 16
+/* 8192 x 8192, a 192 MB memfd */
+#define REQUEST_MAX_PIXELS (1LL << 26)
+
+/*
+ * A draw request. The viewport is the fraction of the dragon to render,
+ * (0, 0, 1, 1) being the whole dragon.
+ *
+ * Requests larger than REQUEST_MAX_PIXELS, or with more threads than the
+ * server has cpus, are rejected. Only the canvas draw, on a cache miss,
+ * runs on the lib backend; the rendering of a cached canvas or of a
+ * viewport always uses OpenMP with nb_thread threads.
+ */
+struct dragon_request {
+	uint64_t size;
+	int32_t width;
+	int32_t height;
+	int32_t nb_thread;
+	float view[4];
+	char lib[REQUEST_LIB_LEN];
+};
+
+/*
+ * The reply is followed by a memfd holding width * height struct rgb
+ * pixels, passed as SCM_RIGHTS ancillary data when status is 0.
+ */
+struct dragon_reply {
+	int32_t status;
+	int32_t width;
+	int32_t height;
+	int32_t hit;
+};
+
+/*
+ * canvas of a dragon, keyed by size, number of colors and backend: the
+ * backends split the iterations differently between the colors
+ */
+struct canvas_entry {
+	uint64_t size;
+	int nb_colors;
+	char lib[REQUEST_LIB_LEN];
+	char *dragon;
+	limits_t limits;
+	uint64_t last_use;
+};
+
+struct canvas_cache {
+	struct canvas_entry *entries;
+	int len;
+	uint64_t clock;
+};
+
+struct canvas_cache *canvas_cache_new(int len);
+void canvas_cache_free(struct canvas_cache *cache);
+struct canvas_entry *canvas_cache_lookup(struct canvas_cache *cache, uint64_t size, int nb_colors,
+		const char *lib);
+int canvas_cache_limits(struct canvas_cache *cache, uint64_t size, limits_t *limits);
+struct canvas_entry *canvas_cache_insert(struct canvas_cache *cache, uint64_t size, int nb_colors,
+		const char *lib, char *dragon, limits_t limits);
+
+int server_listen(const char *path);
+int client_connect(const char *path);
+int image_memfd(int width, int height, struct rgb **image);
+int send_reply(int sock, struct dragon_reply *reply, int fd);
+int recv_reply(int sock, struct dragon_reply *reply, int *fd);
+int read_full(int fd, void *buf, size_t len);
+
+#endif /* DRAGON_SERVER_H_ */
@@ -6,6 +6,8 @@
  */
 
 #include <iostream>
+#include <thread>
+#include <vector>
 
 extern "C" {
 #include "dragon.h"
@@ -14,6 +16,7 @@ extern "C" {
 }
 #include "dragon_tbb.h"
 #include "tbb/tbb.h"
+#include "tuned_loop.h"
 
 using namespace std;
 using namespace tbb;
@@ -46,6 +49,12 @@ typedef spin_rw_mutex Mutex;
 
 Mutex coutMutex;
 
+/* Grain et partitionneur choisis en ligne, voir tuned_loop.h */
+#define TUNE_MAX_DRAWS 100
+static TunedLoop clearLoop("dragon-clear");
+static TunedLoop drawLoop("dragon-draw");
+static TunedLoop renderLoop("dragon-render");
+
 class DragonDraw {
 private:
 	struct draw_data *data;
@@ -113,8 +122,22 @@ public:
 
 int dragon_draw_tbb(char **canvas, struct rgb *image, int width, int height, uint64_t size, int nb_thread)
 {
-	struct draw_data data;
 	limits_t limits;
+
+	/* 1. Calculer les limites du dragon */
+	phase_begin(PHASE_LIMITS);
+	dragon_limits_tbb(&limits, size, nb_thread);
+	phase_end(PHASE_LIMITS);
+
+	return dragon_draw_limits_tbb(canvas, image, width, height, size, nb_thread, &limits);
+}
+
+/* Comme dragon_draw_tbb(), les limites étant déjà connues */
+int dragon_draw_limits_tbb(char **canvas, struct rgb *image, int width, int height, uint64_t size,
+		int nb_thread, const limits_t *known)
+{
+	struct draw_data data;
+	limits_t limits = *known;
 	char *dragon = NULL;
 	int dragon_width;
 	int dragon_height;
@@ -129,9 +152,6 @@ int dragon_draw_tbb(char **canvas, struct rgb *image, int width, int height, uin
 	if (palette == NULL)
 		return -1;
 
-	/* 1. Calculer les limites du dragon */
-	dragon_limits_tbb(&limits, size, nb_thread);
-
 	task_scheduler_init init(nb_thread);
 
 	dragon_width = limits.maximums.x - limits.minimums.x;
@@ -165,16 +185,22 @@ int dragon_draw_tbb(char **canvas, struct rgb *image, int width, int height, uin
 	data.tid = (int *) calloc(nb_thread, sizeof(int));
 
 	/* 2. Initialiser la surface */
+	phase_begin(PHASE_CLEAR);
 	DragonClear dragonClear(&data);
-	parallel_for(blocked_range<int>(0,dragon_surface), dragonClear);
+	clearLoop.parallel_for(0, dragon_surface, dragonClear);
+	phase_end(PHASE_CLEAR);
 
 	/* 3. Dessiner le dragon */
+	phase_begin(PHASE_DRAW);
 	DragonDraw dragonDraw(&data);
-	parallel_for(blocked_range<uint64_t>(0, size), dragonDraw);
+	drawLoop.parallel_for((uint64_t) 0, size, dragonDraw);
+	phase_end(PHASE_DRAW);
 
 	/* 4. Effectuer le rendu final */
+	phase_begin(PHASE_RENDER);
 	DragonRender dragonRender(&data);
-	parallel_for(blocked_range<int>(0,height), dragonRender);
+	renderLoop.parallel_for(0, height, dragonRender);
+	phase_end(PHASE_RENDER);
 
 	init.terminate();
 
@@ -184,6 +210,70 @@ int dragon_draw_tbb(char **canvas, struct rgb *image, int width, int height, uin
 	return 0;
 }
 
+/*
+ * Dessine jusqu'à ce que les trois boucles soient réglées pour cette
+ * taille et ce nombre de threads. Les appels de réglage alternent les
+ * partitionneurs : un banc d'essai appelle ceci avant de mesurer.
+ */
+int dragon_tune_tbb(int width, int height, uint64_t size, int nb_thread)
+{
+	limits_t limits;
+	TuneChoice choice;
+	struct rgb *image;
+	char *dragon = NULL;
+	int tuned = 0;
+	int i;
+
+	if (dragon_limits_tbb(&limits, size, nb_thread) < 0)
+		return -1;
+	int surface = (limits.maximums.x - limits.minimums.x) *
+			(limits.maximums.y - limits.minimums.y);
+
+	image = make_canvas(width, height);
+	if (image == NULL)
+		return -1;
+	for (i = 0; i < TUNE_MAX_DRAWS && !tuned; i++) {
+		if (dragon_draw_limits_tbb(&dragon, image, width, height, size, nb_thread, &limits) < 0)
+			break;
+		FREE(dragon);
+		task_scheduler_init init(nb_thread);
+		tuned = clearLoop.tuned(surface, choice) && drawLoop.tuned(size, choice) &&
+				renderLoop.tuned(height, choice);
+	}
+	FREE(image);
+	return tuned ? 0 : -1;
+}
+
+/*
+ * Appels concurrents d'une même boucle pendant son réglage : chacun doit
+ * mesurer son propre candidat, et le gagnant doit avoir été mesuré.
+ */
+int dragon_check_tune(int nb_thread)
+{
+	TunedLoop loop("dragon-check-tune");
+	vector<thread> threads;
+	TuneChoice choice;
+	double seconds = -1;
+	int i;
+
+	for (i = 0; i < nb_thread; i++) {
+		threads.push_back(thread([&]() {
+			TuneChoice mine;
+			int j;
+			for (j = 0; j < TUNE_MAX_DRAWS && !loop.tuned(1000, mine); j++) {
+				loop.parallel_for(0, 1000, [](const blocked_range<int> &r) {
+					volatile int sum = 0;
+					for (int k = r.begin(); k < r.end(); k++)
+						sum += k;
+				});
+			}
+		}));
+	}
+	for (i = 0; i < nb_thread; i++)
+		threads[i].join();
+	return loop.tuned(1000, choice, &seconds) && seconds >= 0 ? 0 : -1;
+}
+
 /*
  * Calcule les limites en terme de largeur et de hauteur de
  * la forme du dragon. Requis pour allouer la matrice de dessin.
@@ -14,7 +14,11 @@
 extern "C" {
 #endif
 int dragon_draw_tbb(char **canvas, struct rgb *image, int width, int height, uint64_t size, int nb_thread);
+int dragon_draw_limits_tbb(char **canvas, struct rgb *image, int width, int height, uint64_t size,
+		int nb_thread, const limits_t *limits);
 int dragon_limits_tbb(limits_t *limits, uint64_t size, int nb_thread);
+int dragon_tune_tbb(int width, int height, uint64_t size, int nb_thread);
+int dragon_check_tune(int nb_thread);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,11 @@
+/*
+ * dragon_tp.c
+ *
+ * Probes of the dragonizer tracepoint provider.
+ */
+
+#ifdef DRAGON_TRACE
+#define TRACEPOINT_CREATE_PROBES
+#define TRACEPOINT_DEFINE
+#include "dragon_tp.h"
+#endif
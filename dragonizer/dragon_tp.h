@@ -0,0 +1,68 @@
+#undef TRACEPOINT_PROVIDER
+#define TRACEPOINT_PROVIDER dragonizer
+
+#undef TRACEPOINT_INCLUDE
+#define TRACEPOINT_INCLUDE "./dragon_tp.h"
+
+#if !defined(_DRAGON_TP_H) || defined(TRACEPOINT_HEADER_MULTI_READ)
+#define _DRAGON_TP_H
+#include <stdint.h>
+#include <lttng/tracepoint.h>
+
+/* phase is an enum dragon_phase */
+TRACEPOINT_EVENT(
+        dragonizer,
+        phase_begin,
+        TP_ARGS(int, phase),
+        TP_FIELDS(
+            ctf_integer(int, phase, phase)
+        )
+)
+
+TRACEPOINT_EVENT(
+        dragonizer,
+        phase_end,
+        TP_ARGS(int, phase),
+        TP_FIELDS(
+            ctf_integer(int, phase, phase)
+        )
+)
+
+/* range of the dragon drawn by dragon_draw_raw() */
+TRACEPOINT_EVENT(
+        dragonizer,
+        chunk_entry,
+        TP_ARGS(uint64_t, start, uint64_t, end, int, id),
+        TP_FIELDS(
+            ctf_integer(uint64_t, start, start)
+            ctf_integer(uint64_t, end, end)
+            ctf_integer(int, id, id)
+        )
+)
+
+TRACEPOINT_EVENT(dragonizer, chunk_exit, TP_ARGS(), TP_FIELDS())
+
+/* worker id waiting on the barrier that ends phase */
+TRACEPOINT_EVENT(
+        dragonizer,
+        barrier_entry,
+        TP_ARGS(int, id, int, phase),
+        TP_FIELDS(
+            ctf_integer(int, id, id)
+            ctf_integer(int, phase, phase)
+        )
+)
+
+TRACEPOINT_EVENT(
+        dragonizer,
+        barrier_exit,
+        TP_ARGS(int, id, int, phase),
+        TP_FIELDS(
+            ctf_integer(int, id, id)
+            ctf_integer(int, phase, phase)
+        )
+)
+
+#endif /* _DRAGON_TP_H */
+
+#include <lttng/tracepoint-event.h>
@@ -0,0 +1,17 @@
+/*
+ * dragon_trace.h
+ *
+ * LTTng-UST instrumentation of the dragonizer. The tracepoints are compiled
+ * out unless built with DRAGON_TRACE (qmake CONFIG+=trace).
+ */
+
+#ifndef DRAGON_TRACE_H_
+#define DRAGON_TRACE_H_
+
+#ifdef DRAGON_TRACE
+#include "dragon_tp.h"
+#else
+#define tracepoint(...) do { } while (0)
+#endif
+
+#endif /* DRAGON_TRACE_H_ */
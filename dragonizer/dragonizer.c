@@ -21,10 +21,14 @@
 #include <inttypes.h>
 #include <time.h>
 #include <math.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 
 #include "dragon.h"
 #include "dragon_pthread.h"
 #include "dragon_tbb.h"
+#include "dragon_server.h"
 
 /* Globals and defaults */
 #define PROGNAME "dragonizer"
@@ -38,6 +42,7 @@
 #define POWER_BENCH 	25
 #define CHECK_POWER 	20
 #define CHECK_NB_THREAD	8
+#define BENCH_REPEAT	10
 static const struct command_def const *commands[];
 int verbose = 0;
 
@@ -53,6 +58,15 @@ enum thread_lib {
 	THREAD_LIB_TBB,
 };
 
+/*
+ * Strong scaling keeps the dragon size fixed while adding threads, weak
+ * scaling grows the size proportionally with the number of threads.
+ */
+enum scaling_mode {
+	SCALING_STRONG,
+	SCALING_WEAK,
+};
+
 struct command_opts {
 	const struct command_def *cmd;
 	const struct lib_def *lib;
@@ -63,38 +77,50 @@ struct command_opts {
 	int power;
 	int power_max;
 	int verbose;
+	enum scaling_mode scaling;
 	uint64_t size;
+	char *socket_path;
+	float view[4];
+	int cache_len;
 };
 
 typedef int (*draw_handler)(char **, struct rgb *, int, int, uint64_t, int);
 typedef int (*limits_handler)(limits_t *, uint64_t, int);
+typedef int (*draw_limits_handler)(char **, struct rgb *, int, int, uint64_t, int, const limits_t *);
 
 struct lib_def {
 	const char *name;
 	enum thread_lib lib;
 	draw_handler draw_handler;
 	limits_handler limits_handler;
+	draw_limits_handler draw_limits_handler;
 };
 
 static const struct lib_def libs[] = {
 		{ .name = "serial",
 				.lib = THREAD_LIB_SERIAL,
 				.draw_handler = dragon_draw_serial,
-				.limits_handler = dragon_limits_serial },
+				.limits_handler = dragon_limits_serial,
+				.draw_limits_handler = dragon_draw_limits_serial },
 		{ .name = "pthread",
 				.lib = THREAD_LIB_PTHREAD,
 				.draw_handler = dragon_draw_pthread,
-				.limits_handler = dragon_limits_pthread },
+				.limits_handler = dragon_limits_pthread,
+				.draw_limits_handler = dragon_draw_limits_pthread },
 		{ .name = "tbb",
 				.lib = THREAD_LIB_TBB,
 				.draw_handler = dragon_draw_tbb,
-				.limits_handler = dragon_limits_tbb },
+				.limits_handler = dragon_limits_tbb,
+				.draw_limits_handler = dragon_draw_limits_tbb },
 		{ .name = NULL,
 				.lib = THREAD_LIB_NONE,
 				.draw_handler = NULL,
-				.limits_handler = NULL },
+				.limits_handler = NULL,
+				.draw_limits_handler = NULL },
 };
 
+static const struct lib_def *lookup_lib(const char *name);
+
 typedef int (*cmd_handler)(struct command_opts*);
 
 struct command_def {
@@ -108,7 +134,7 @@ static void usage(void)
 	fprintf(stderr, "Usage: " PROGNAME " [OPTIONS] [COMMAND]\n");
 	fprintf(stderr, "\nOptions:\n");
 	fprintf(stderr, "  --help	this help\n");
-	fprintf(stderr, "  --cmd		command [ draw | limits | check ]\n");
+	fprintf(stderr, "  --cmd		command [ draw | limits | check | benchmark | serve | request ]\n");
 	fprintf(stderr, "  --thread	set number of threads\n");
 	fprintf(stderr, "  --lib		set the threading library to use "\
 			"[ serial | pthread | tbb ]\n");
@@ -118,6 +144,10 @@ static void usage(void)
 	fprintf(stderr, "  --size	set dragon size\n");
 	fprintf(stderr, "  --power  set dragon size by power\n");
 	fprintf(stderr, "  --max    compute all dragon to max power\n");
+	fprintf(stderr, "  --scaling benchmark scaling mode [ strong | weak ]\n");
+	fprintf(stderr, "  --socket  service socket path\n");
+	fprintf(stderr, "  --view    requested viewport x0,y0,x1,y1 in [0,1]\n");
+	fprintf(stderr, "  --cache   number of canvas kept by the service\n");
 	fprintf(stderr, "\n");
 	exit(EXIT_FAILURE);
 }
@@ -336,6 +366,95 @@ err:
 	goto done;
 }
 
+/*
+ * the planar render converted back to rgb must be the same image as the
+ * packed one, and the packed render split into planes the same planes as
+ * the planar one
+ */
+static int check_render(struct command_opts *opts)
+{
+	int ret = 0;
+	limits_t limits;
+	char *drg = NULL;
+	struct rgb *img_exp = NULL, *img_act = NULL;
+	struct planes *planes = NULL, *split = NULL;
+	struct palette *palette = NULL;
+	int area = opts->width * opts->height;
+
+	if (dragon_limits_serial(&limits, opts->size, opts->nb_thread) < 0) {
+		printf("Error: limits serial failed\n");
+		goto err;
+	}
+
+	img_exp = make_canvas(opts->width, opts->height);
+	img_act = make_canvas(opts->width, opts->height);
+	planes = make_planes(opts->width, opts->height);
+	split = make_planes(opts->width, opts->height);
+	palette = init_palette(opts->nb_thread);
+	if (img_exp == NULL || img_act == NULL || planes == NULL || split == NULL || palette == NULL)
+		goto err;
+
+	if (dragon_draw_serial(&drg, img_exp, opts->width, opts->height, opts->size, opts->nb_thread) < 0) {
+		printf("Error: draw serial failed\n");
+		goto err;
+	}
+	scale_dragon_planar(0, opts->height, planes, drg,
+			limits.maximums.x - limits.minimums.x,
+			limits.maximums.y - limits.minimums.y, palette);
+	planes_to_rgb(planes, img_act);
+
+	if (memcmp(img_exp, img_act, sizeof(struct rgb) * opts->width * opts->height) == 0) {
+		printf("PASS %10s %10s\n", "render", "planar");
+	} else {
+		ret = -1;
+		printf("FAIL %10s %10s\n", "render", "planar");
+	}
+
+	/* packed -> planar -> packed, the planes against the scalar render */
+	memset(img_act, 0, sizeof(struct rgb) * area);
+	rgb_to_planes(img_exp, split);
+	planes_to_rgb(split, img_act);
+	if (memcmp(split->r, planes->r, area) == 0 &&
+			memcmp(split->g, planes->g, area) == 0 &&
+			memcmp(split->b, planes->b, area) == 0 &&
+			memcmp(img_exp, img_act, sizeof(struct rgb) * area) == 0) {
+		printf("PASS %10s %10s\n", "convert", "planar");
+	} else {
+		ret = -1;
+		printf("FAIL %10s %10s\n", "convert", "planar");
+	}
+
+done:
+	FREE(img_exp);
+	FREE(img_act);
+	FREE(drg);
+	free_planes(planes);
+	free_planes(split);
+	free_palette(palette);
+	return ret;
+err:
+	ret = -1;
+	goto done;
+}
+
+/*
+ * concurrent calls of a tbb loop being tuned, the winner must have been
+ * measured. A winner read from TBBTUNE_FILE has no measurement.
+ */
+static int check_tune(struct command_opts *opts)
+{
+	if (getenv("TBBTUNE_FILE") != NULL) {
+		printf("SKIP %10s %10s TBBTUNE_FILE set\n", "tune", "concurrent");
+		return 0;
+	}
+	if (dragon_check_tune(opts->nb_thread) < 0) {
+		printf("FAIL %10s %10s\n", "tune", "concurrent");
+		return -1;
+	}
+	printf("PASS %10s %10s\n", "tune", "concurrent");
+	return 0;
+}
+
 static int cmd_check(struct command_opts *opts)
 {
 	int ret = 0;
@@ -343,37 +462,70 @@ static int cmd_check(struct command_opts *opts)
 		ret = -1;
 	if (check_draw(opts) < 0)
 		ret = -1;
+	if (check_render(opts) < 0)
+		ret = -1;
+	if (check_tune(opts) < 0)
+		ret = -1;
 	return ret;
 }
 
 static const struct command_def cmd_check_def =
 { .name = "check", .handler = cmd_check };
 
-double seconds(struct timespec *t)
+/*
+ * Karp-Flatt metric: experimentally determined serial fraction
+ * e = (1/S - 1/p) / (1 - 1/p), undefined for a single thread.
+ */
+static double karp_flatt(double speedup, int threads)
 {
-    return t->tv_sec + 1.0E-9 * t->tv_nsec;
+	if (threads < 2)
+		return 0;
+	return (1 / speedup - 1.0 / threads) / (1 - 1.0 / threads);
 }
 
 static int cmd_benchmark(struct command_opts *opts)
 {
     int ret = 0;
     char *drg = NULL;
+    char *path = NULL;
+    FILE *out = NULL;
     int cpus = sysconf(_SC_NPROCESSORS_ONLN);
-    double samples[10];
+    int weak = (opts->scaling == SCALING_WEAK);
+    double samples[BENCH_REPEAT];
+    double phases[PHASE_COUNT];
 
     double serial_mean = 0;
 
     for (int i = 0; libs[i].lib != THREAD_LIB_NONE; i++) {
-        char *path;
-        ret = asprintf(&path, "%s.dat", libs[i].name);
-        FILE *out = fopen(path, "w");
+        if (asprintf(&path, "%s%s.dat", libs[i].name, weak ? ".weak" : "") < 0)
+            goto err;
+        out = fopen(path, "w");
         if (!out)
             goto err;
+        fprintf(out, "# threads mean sd speedup efficiency karp_flatt size");
+        for (int p = 0; p < PHASE_COUNT; p++)
+            fprintf(out, " %s", phase_names[p]);
+        fprintf(out, "\n");
         int nr_thread = cpus;
         if (libs[i].lib == THREAD_LIB_SERIAL)
             nr_thread = 1;
         for (int threads = 1; threads <= nr_thread; threads++) {
-            for (int repeat = 0; repeat < 10; repeat++) {
+            uint64_t size = opts->size;
+            if (weak)
+                size = opts->size * threads;
+            if (size > (1LL << POWER_MAX)) {
+                printf("%s: size %"PRId64" too large, stopping at %d threads\n",
+                        libs[i].name, size, threads - 1);
+                break;
+            }
+            /* the tuning draws rotate the partitioners, they are not measured */
+            if (libs[i].lib == THREAD_LIB_TBB &&
+                    dragon_tune_tbb(opts->width, opts->height, size, threads) < 0) {
+                printf("Error tuning %s\n", libs[i].name);
+                goto err;
+            }
+            memset(phases, 0, sizeof(phases));
+            for (int repeat = 0; repeat < BENCH_REPEAT; repeat++) {
                 struct timespec t1, t2;
 
                 clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
@@ -381,9 +533,11 @@ static int cmd_benchmark(struct command_opts *opts)
                 struct rgb *img = make_canvas(opts->width, opts->height);
                 if (img == NULL)
                     goto err;
-                ret = libs[i].draw_handler(&drg, img, opts->width, opts->height, opts->size, threads);
+                phase_reset();
+                ret = libs[i].draw_handler(&drg, img, opts->width, opts->height, size, threads);
                 if (ret < 0) {
                     printf("Error executing draw with %s\n", libs[i].name);
+                    FREE(img);
                     goto err;
                 }
                 write_img(img, opts->pgm_path, opts->width, opts->height);
@@ -391,39 +545,64 @@ static int cmd_benchmark(struct command_opts *opts)
                 FREE(drg);
                 clock_gettime(CLOCK_MONOTONIC_RAW, &t2);
                 double elapsed = seconds(&t2) - seconds(&t1);
-                printf("%-10s %d %d %0.3f\n", libs[i].name, threads, repeat, elapsed);
+                printf("%-10s %d %d %"PRId64" %0.3f\n", libs[i].name, threads, repeat, size, elapsed);
                 samples[repeat] = elapsed;
+                for (int p = 0; p < PHASE_COUNT; p++)
+                    phases[p] += phase_elapsed[p];
             }
             double mean = 0;
             double sd = 0;
             double temp = 0;
 
-            for (int x = 0; x < 10; x++) {
+            for (int x = 0; x < BENCH_REPEAT; x++) {
                 temp += samples[x];
             }
-            mean = temp / 10;
+            mean = temp / BENCH_REPEAT;
 
             // compute sd
             temp = 0;
-            for (int x = 0; x < 10; x++) {
+            for (int x = 0; x < BENCH_REPEAT; x++) {
                 double v = (samples[x] - mean);
                 temp += v * v;
             }
-            sd = sqrt(temp);
+            sd = sqrt(temp / BENCH_REPEAT);
 
             if (libs[i].lib == THREAD_LIB_SERIAL) {
                 serial_mean = mean;
             }
 
+            /*
+             * In weak scaling, the serial run at the base size is the ideal
+             * time for every thread count, and the speedup is scaled by the
+             * amount of work added (Gustafson).
+             */
             double speedup = serial_mean / mean;
+            if (weak)
+                speedup *= threads;
             double efficiency = speedup / threads;
-
-            fprintf(out, "%d %f %f %f %f\n", threads, mean, sd, speedup, efficiency);
+            double serial_fraction = karp_flatt(speedup, threads);
+
+            fprintf(out, "%d %f %f %f %f %f %"PRId64, threads, mean, sd,
+                    speedup, efficiency, serial_fraction, size);
+            printf("%-10s %s threads=%d size=%"PRId64" mean=%0.3f efficiency=%0.3f karp-flatt=%0.3f",
+                    libs[i].name, weak ? "weak" : "strong", threads, size, mean,
+                    efficiency, serial_fraction);
+            for (int p = 0; p < PHASE_COUNT; p++) {
+                fprintf(out, " %f", phases[p] / BENCH_REPEAT);
+                printf(" %s=%0.3f", phase_names[p], phases[p] / BENCH_REPEAT);
+            }
+            fprintf(out, "\n");
+            printf("\n");
         }
         fclose(out);
+        out = NULL;
+        FREE(path);
     }
 
 done:
+    if (out)
+        fclose(out);
+    FREE(path);
     return ret;
 err:
     ret = -1;
@@ -433,6 +612,240 @@ err:
 static const struct command_def cmd_benchmark_def =
 { .name = "benchmark", .handler = cmd_benchmark };
 
+static volatile sig_atomic_t serve_stop = 0;
+
+static void serve_signal(int sig)
+{
+	(void) sig;
+	serve_stop = 1;
+}
+
+static int view_valid(const float *view)
+{
+	return view[0] >= 0 && view[1] >= 0 && view[2] <= 1 && view[3] <= 1 &&
+			view[0] < view[2] && view[1] < view[3];
+}
+
+static int view_full(const float *view)
+{
+	return view[0] == 0 && view[1] == 0 && view[2] == 1 && view[3] == 1;
+}
+
+/* render the requested viewport of a cached canvas, with OpenMP whatever the backend */
+static int render_view(struct canvas_entry *entry, struct dragon_request *req, struct rgb *image)
+{
+	int dragon_width = entry->limits.maximums.x - entry->limits.minimums.x;
+	int dragon_height = entry->limits.maximums.y - entry->limits.minimums.y;
+	int x0 = req->view[0] * dragon_width;
+	int y0 = req->view[1] * dragon_height;
+	int x1 = req->view[2] * dragon_width;
+	int y1 = req->view[3] * dragon_height;
+	int y;
+
+	if (x1 <= x0)
+		x1 = x0 + 1;
+	if (y1 <= y0)
+		y1 = y0 + 1;
+
+	struct palette *palette = init_palette(entry->nb_colors);
+	if (palette == NULL)
+		return -1;
+
+	#pragma omp parallel for num_threads(req->nb_thread)
+	for (y = 0; y < req->height; y++) {
+		scale_dragon_view(y, y + 1, image, req->width, req->height, entry->dragon,
+				dragon_width, x0, y0, x1 - x0, y1 - y0, palette);
+	}
+	free_palette(palette);
+	return 0;
+}
+
+/*
+ * Draw the request into a new memfd. Canvas are reused from the cache,
+ * only the final rendering is done on a hit.
+ */
+static int serve_request(struct canvas_cache *cache, struct dragon_request *req,
+		struct dragon_reply *reply)
+{
+	const struct lib_def *lib;
+	struct canvas_entry *entry;
+	struct rgb *image = NULL;
+	char *dragon = NULL;
+	limits_t limits;
+	int fd = -1;
+
+	req->lib[REQUEST_LIB_LEN - 1] = '\0';
+	lib = lookup_lib(req->lib);
+	if (lib == NULL || req->width <= 0 || req->height <= 0 ||
+			(int64_t) req->width * req->height > REQUEST_MAX_PIXELS ||
+			req->nb_thread <= 0 || req->nb_thread > sysconf(_SC_NPROCESSORS_ONLN) ||
+			req->size == 0 || req->size > (1LL << POWER_MAX) || !view_valid(req->view)) {
+		printf("invalid request\n");
+		return -1;
+	}
+
+	fd = image_memfd(req->width, req->height, &image);
+	if (fd < 0)
+		return -1;
+
+	entry = canvas_cache_lookup(cache, req->size, req->nb_thread, lib->name);
+	reply->hit = (entry != NULL);
+	if (entry == NULL) {
+		/* the limits are computed once per size, whatever the backend */
+		if (canvas_cache_limits(cache, req->size, &limits) < 0 &&
+				lib->limits_handler(&limits, req->size, req->nb_thread) < 0)
+			goto err;
+		if (lib->draw_limits_handler(&dragon, image, req->width, req->height,
+				req->size, req->nb_thread, &limits) < 0)
+			goto err;
+		entry = canvas_cache_insert(cache, req->size, req->nb_thread, lib->name, dragon, limits);
+	}
+	if (reply->hit || !view_full(req->view)) {
+		if (render_view(entry, req, image) < 0)
+			goto err;
+	}
+
+	munmap(image, sizeof(struct rgb) * req->width * req->height);
+	reply->width = req->width;
+	reply->height = req->height;
+	return fd;
+err:
+	FREE(dragon);
+	munmap(image, sizeof(struct rgb) * req->width * req->height);
+	close(fd);
+	return -1;
+}
+
+static void serve_client(struct canvas_cache *cache, int client, int verbose)
+{
+	struct dragon_request req;
+
+	while (read_full(client, &req, sizeof(req)) == 0) {
+		struct dragon_reply reply;
+		memset(&reply, 0, sizeof(reply));
+		int fd = serve_request(cache, &req, &reply);
+		reply.status = (fd < 0) ? -1 : 0;
+		if (verbose)
+			printf("request size=%"PRId64" %dx%d lib=%s thread=%d %s\n",
+					req.size, req.width, req.height, req.lib, req.nb_thread,
+					reply.hit ? "hit" : "miss");
+		int ret = send_reply(client, &reply, fd);
+		if (fd >= 0)
+			close(fd);
+		if (ret < 0)
+			break;
+	}
+}
+
+static int cmd_serve(struct command_opts *opts)
+{
+	struct canvas_cache *cache = NULL;
+	struct sigaction sa;
+	int sock = -1;
+	int ret = 0;
+
+	cache = canvas_cache_new(opts->cache_len);
+	if (cache == NULL)
+		goto err;
+
+	sock = server_listen(opts->socket_path);
+	if (sock < 0)
+		goto err;
+
+	/* no SA_RESTART, accept() returns on SIGINT and SIGTERM */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = serve_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	printf("listening on %s\n", opts->socket_path);
+	while (!serve_stop) {
+		int client = accept(sock, NULL, NULL);
+		if (client < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("accept");
+			goto err;
+		}
+		serve_client(cache, client, opts->verbose);
+		close(client);
+	}
+
+done:
+	if (sock >= 0) {
+		close(sock);
+		unlink(opts->socket_path);
+	}
+	canvas_cache_free(cache);
+	return ret;
+err:
+	ret = -1;
+	goto done;
+}
+
+static const struct command_def cmd_serve_def =
+{ .name = "serve", .handler = cmd_serve };
+
+static int cmd_request(struct command_opts *opts)
+{
+	struct dragon_request req;
+	struct dragon_reply reply;
+	struct rgb *image = MAP_FAILED;
+	size_t len = 0;
+	int sock = -1;
+	int fd = -1;
+	int ret = 0;
+
+	memset(&req, 0, sizeof(req));
+	req.size = opts->size;
+	req.width = opts->width;
+	req.height = opts->height;
+	req.nb_thread = opts->nb_thread;
+	memcpy(req.view, opts->view, sizeof(req.view));
+	strncpy(req.lib, opts->lib->name, REQUEST_LIB_LEN - 1);
+
+	sock = client_connect(opts->socket_path);
+	if (sock < 0)
+		goto err;
+
+	if (send(sock, &req, sizeof(req), MSG_NOSIGNAL) != sizeof(req)) {
+		perror("send");
+		goto err;
+	}
+	if (recv_reply(sock, &reply, &fd) < 0)
+		goto err;
+	if (reply.status < 0 || fd < 0) {
+		printf("Error: request failed\n");
+		goto err;
+	}
+	if (opts->verbose)
+		printf("%s\n", reply.hit ? "hit" : "miss");
+
+	len = sizeof(struct rgb) * reply.width * reply.height;
+	image = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (image == MAP_FAILED) {
+		perror("mmap");
+		goto err;
+	}
+	if (write_img(image, opts->pgm_path, reply.width, reply.height) < 0)
+		goto err;
+
+done:
+	if (image != MAP_FAILED)
+		munmap(image, len);
+	if (fd >= 0)
+		close(fd);
+	if (sock >= 0)
+		close(sock);
+	return ret;
+err:
+	ret = -1;
+	goto done;
+}
+
+static const struct command_def cmd_request_def =
+{ .name = "request", .handler = cmd_request };
+
 static const struct command_def cmd_def_last =
 { .name = NULL, .handler = NULL };
 
@@ -441,6 +854,8 @@ static const struct command_def const *commands[] = {
 		&cmd_limit_def,
 		&cmd_check_def,
         &cmd_benchmark_def,
+		&cmd_serve_def,
+		&cmd_request_def,
 		&cmd_def_last
 };
 
@@ -476,6 +891,7 @@ static void dump_opts(struct command_opts *opts)
 	printf("%10s %" PRId64 "\n", "size", opts->size);
 	printf("%10s %d\n", "power", opts->power);
 	printf("%10s %d\n", "max", opts->power_max);
+	printf("%10s %s\n", "scaling", opts->scaling == SCALING_WEAK ? "weak" : "strong");
 }
 
 void default_int_value(int *val, int def)
@@ -501,13 +917,19 @@ static int parse_opts(int argc, char **argv, struct command_opts *opts)
 			{ "size",	 1, 0, 's' },
 			{ "power",	 1, 0, 'p' },
 			{ "max",	 1, 0, 'm' },
+			{ "scaling", 1, 0, 'S' },
+			{ "socket",	 1, 0, 'u' },
+			{ "view",	 1, 0, 'w' },
+			{ "cache",	 1, 0, 'k' },
 			{ "verbose", 0, 0, 'v' },
 			{ 0, 0, 0, 0}
 	};
 
 	memset(opts, 0, sizeof(struct command_opts));
+	opts->view[2] = 1;
+	opts->view[3] = 1;
 
-	while ((opt = getopt_long(argc, argv, "hvx:y:s:c:t:l:p:o:m:", options, &idx)) != -1) {
+	while ((opt = getopt_long(argc, argv, "hvx:y:s:c:t:l:p:o:m:S:u:w:k:", options, &idx)) != -1) {
 		switch(opt) {
 		case 'c':
 			opts->cmd = lookup_cmd(optarg);
@@ -541,6 +963,30 @@ static int parse_opts(int argc, char **argv, struct command_opts *opts)
 		case 'm':
 			opts->power_max = atoi(optarg);
 			break;
+		case 'S':
+			if (strcmp(optarg, "strong") == 0) {
+				opts->scaling = SCALING_STRONG;
+			} else if (strcmp(optarg, "weak") == 0) {
+				opts->scaling = SCALING_WEAK;
+			} else {
+				printf("unknown scaling mode %s\n", optarg);
+				ret = -1;
+			}
+			break;
+		case 'u':
+			if (asprintf(&opts->socket_path, "%s", optarg) < 0)
+				goto err;
+			break;
+		case 'w':
+			if (sscanf(optarg, "%f,%f,%f,%f", &opts->view[0], &opts->view[1],
+					&opts->view[2], &opts->view[3]) != 4 || !view_valid(opts->view)) {
+				printf("Error: invalid view %s\n", optarg);
+				ret = -1;
+			}
+			break;
+		case 'k':
+			opts->cache_len = atoi(optarg);
+			break;
 		case 'h':
 			usage();
 			break;
@@ -561,6 +1007,9 @@ static int parse_opts(int argc, char **argv, struct command_opts *opts)
 	if (opts->pgm_path == NULL)
 		opts->pgm_path = DEFAULT_IMG_PATH;
 
+	if (opts->socket_path == NULL)
+		opts->socket_path = DEFAULT_SOCKET_PATH;
+
 	if (opts->size > (1LL << POWER_MAX)) {
 		printf("Error: size must be lower or equals to %"PRId64"\n", opts->size);
 		ret = -1;
@@ -591,6 +1040,7 @@ static int parse_opts(int argc, char **argv, struct command_opts *opts)
 	default_int_value(&opts->height, DEFAULT_HEIGHT);
 	default_int_value(&opts->width, DEFAULT_WIDTH);
 	default_int_value(&opts->nb_thread, DEFAULT_NB_THREAD);
+	default_int_value(&opts->cache_len, DEFAULT_CACHE_LEN);
 
 	if (opts->width == 0 || opts->height == 0) {
 		fprintf(stderr, "argument error: height and width must be greater than 0\n");
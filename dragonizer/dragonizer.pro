@@ -13,15 +13,28 @@ QMAKE_CFLAGS += -fopenmp
 QMAKE_CXXFLAGS += -fopenmp
 QMAKE_LFLAGS += -fopenmp
 
+# LTTng-UST tracepoints: qmake CONFIG+=trace
+trace {
+    DEFINES += DRAGON_TRACE
+    LIBS += -llttng-ust -ldl
+}
+
 SOURCES += dragonizer.c \
     dragon.c \
     color.c \
     dragon_pthread.c \
     dragon_tbb.cpp \
+    dragon_tp.c \
+    dragon_server.c \
     utils.c
 
 HEADERS += color.h \
     dragon.h \
     dragon_pthread.h \
     dragon_tbb.h \
+    dragon_tp.h \
+    dragon_trace.h \
+    dragon_server.h \
     utils.h
+
+include(../tbbtune/tbbtune.pri)
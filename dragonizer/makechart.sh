@@ -1,6 +1,7 @@
 #!/bin/sh
 
 # argument 1 is path to input
+# argument 2 is the scaling mode of the benchmark [ strong | weak ]
 # set style line 1 ls rgb '#0060ad' lt 1 t
 
 if [ ! -d "$1" ]; then
@@ -10,13 +11,18 @@ fi
 
 RANGE="[0:5]"
 
+SUFFIX=""
+if [ "$2" = "weak" ]; then
+    SUFFIX=".weak"
+fi
+
 gnuplot << EOF
 set terminal png
 set output 'time.png'
 set title 'Elapsed time according to number of cores'
 set xrange $RANGE
-plot '$1/pthread.dat' using 1:2 title "pthread" with linespoints, \
-     '$1/tbb.dat' using 1:2 title "tbb" with linespoint
+plot '$1/pthread$SUFFIX.dat' using 1:2 title "pthread" with linespoints, \
+     '$1/tbb$SUFFIX.dat' using 1:2 title "tbb" with linespoint
 EOF
 
 gnuplot << EOF
@@ -24,8 +30,8 @@ set terminal png
 set output 'speedup.png'
 set title 'Speedup according to number of cores'
 set xrange $RANGE
-plot '$1/pthread.dat' using 1:4 title "pthread" with linespoints, \
-     '$1/tbb.dat' using 1:4 title "tbb" with linespoint
+plot '$1/pthread$SUFFIX.dat' using 1:4 title "pthread" with linespoints, \
+     '$1/tbb$SUFFIX.dat' using 1:4 title "tbb" with linespoint
 EOF
 
 gnuplot << EOF
@@ -33,7 +39,16 @@ set terminal png
 set output 'efficiency.png'
 set title 'Efficiency according to number of cores'
 set xrange $RANGE
-plot '$1/pthread.dat' using 1:5 title "pthread" with linespoints, \
-     '$1/tbb.dat' using 1:5 title "tbb" with linespoint
+plot '$1/pthread$SUFFIX.dat' using 1:5 title "pthread" with linespoints, \
+     '$1/tbb$SUFFIX.dat' using 1:5 title "tbb" with linespoint
 EOF
 
+
+gnuplot << EOF
+set terminal png
+set output 'serial-fraction.png'
+set title 'Karp-Flatt serial fraction according to number of cores'
+set xrange $RANGE
+plot '$1/pthread$SUFFIX.dat' using 1:6 title "pthread" with linespoints, \
+     '$1/tbb$SUFFIX.dat' using 1:6 title "tbb" with linespoint
+EOF
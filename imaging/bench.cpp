@@ -0,0 +1,71 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+TrialStats run_trials(const std::function<void ()> &reset, const std::function<void ()> &body,
+                      int warmups, int trials)
+{
+    std::vector<double> samples;
+    for (int i = 0; i < warmups + trials; i++) {
+        reset();
+        auto t1 = std::chrono::steady_clock::now();
+        body();
+        auto t2 = std::chrono::steady_clock::now();
+        if (i >= warmups)
+            samples.push_back(std::chrono::duration<double, std::nano>(t2 - t1).count());
+    }
+    return trial_stats(samples);
+}
+
+// linear interpolation between the closest ranks of sorted samples
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    double rank = p * (sorted.size() - 1);
+    size_t lo = (size_t) rank;
+    size_t hi = std::min(lo + 1, sorted.size() - 1);
+    return sorted[lo] + (rank - lo) * (sorted[hi] - sorted[lo]);
+}
+
+TrialStats trial_stats(std::vector<double> samples)
+{
+    TrialStats stats = TrialStats();
+    stats.trials = samples.size();
+    if (samples.empty())
+        return stats;
+    std::sort(samples.begin(), samples.end());
+    stats.min = samples.front();
+    stats.p10 = percentile(samples, 0.10);
+    stats.median = percentile(samples, 0.50);
+    stats.p90 = percentile(samples, 0.90);
+    stats.max = samples.back();
+    stats.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    return stats;
+}
+
+std::string trial_csv_header()
+{
+    return "trials,min,p10,median,p90,max,mean";
+}
+
+std::string trial_csv(const TrialStats &stats)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%d,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f", stats.trials,
+             stats.min, stats.p10, stats.median, stats.p90, stats.max, stats.mean);
+    return buf;
+}
+
+bool pin_current_thread(int cpu)
+{
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % ncpus, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
@@ -0,0 +1,34 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+ * Repeated trials of a benchmark. reset() restores the input before each
+ * trial and is not timed, the warmup trials are run the same way and
+ * discarded. Times are in nanoseconds.
+ */
+struct TrialStats {
+    int trials;
+    double min;
+    double p10;
+    double median;
+    double p90;
+    double max;
+    double mean;
+};
+
+TrialStats run_trials(const std::function<void ()> &reset, const std::function<void ()> &body,
+                      int warmups, int trials);
+TrialStats trial_stats(std::vector<double> samples);
+
+// CSV columns of a TrialStats, after the columns of the caller
+std::string trial_csv_header();
+std::string trial_csv(const TrialStats &stats);
+
+// bind the calling thread to a single cpu, modulo the number of cpus
+bool pin_current_thread(int cpu);
+
+#endif // BENCH_H
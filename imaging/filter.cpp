@@ -0,0 +1,322 @@
+#include "filter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+static inline int clamp_channel(int c)
+{
+    return c < 0 ? 0 : (c > 255 ? 255 : c);
+}
+
+static inline uint32_t pack(int r, int g, int b)
+{
+    return 0xff000000u | (r << 16) | (g << 8) | b;
+}
+
+FilterChain::Stage &FilterChain::lutStage()
+{
+    Stage stage = Stage();
+    stage.type = LUT;
+    stage.size = 0;
+    for (int c = 0; c < 3; c++) {
+        for (int x = 0; x < 256; x++) {
+            stage.lut[c][x] = x;
+        }
+    }
+    m_stages.push_back(stage);
+    return m_stages.back();
+}
+
+FilterChain &FilterChain::shift(int dr, int dg, int db)
+{
+    Stage &stage = lutStage();
+    int delta[3] = { dr, dg, db };
+    for (int c = 0; c < 3; c++) {
+        for (int x = 0; x < 256; x++) {
+            stage.lut[c][x] = clamp_channel(x + delta[c]);
+        }
+    }
+    return *this;
+}
+
+// out = 255 * (in / 255) ^ (1 / gamma)
+FilterChain &FilterChain::gamma(double gamma)
+{
+    Stage &stage = lutStage();
+    for (int x = 0; x < 256; x++) {
+        int v = std::lround(255.0 * std::pow(x / 255.0, 1.0 / gamma));
+        for (int c = 0; c < 3; c++) {
+            stage.lut[c][x] = clamp_channel(v);
+        }
+    }
+    return *this;
+}
+
+// per channel, binary black and white when applied after grayscale
+FilterChain &FilterChain::threshold(int level)
+{
+    Stage &stage = lutStage();
+    for (int x = 0; x < 256; x++) {
+        for (int c = 0; c < 3; c++) {
+            stage.lut[c][x] = (x >= level) ? 255 : 0;
+        }
+    }
+    return *this;
+}
+
+FilterChain &FilterChain::grayscale()
+{
+    Stage stage = Stage();
+    stage.type = GRAY;
+    stage.size = 0;
+    m_stages.push_back(stage);
+    return *this;
+}
+
+FilterChain &FilterChain::lut(const uint8_t table[3][256])
+{
+    Stage &stage = lutStage();
+    memcpy(stage.lut, table, sizeof(stage.lut));
+    return *this;
+}
+
+FilterChain &FilterChain::convolve(const std::vector<float> &kernel, int size)
+{
+    Stage stage = Stage();
+    stage.type = CONVOLVE;
+    stage.kernel = kernel;
+    stage.size = size;
+    m_stages.push_back(stage);
+    return *this;
+}
+
+bool FilterChain::parse(const std::string &spec)
+{
+    std::stringstream stages(spec);
+    std::string item;
+    while (std::getline(stages, item, ';')) {
+        std::string name = item.substr(0, item.find(':'));
+        std::string args = item.find(':') == std::string::npos ? "" : item.substr(item.find(':') + 1);
+        if (name == "shift") {
+            int dr, dg, db;
+            if (sscanf(args.c_str(), "%d,%d,%d", &dr, &dg, &db) != 3)
+                return false;
+            shift(dr, dg, db);
+        } else if (name == "gamma") {
+            double g = atof(args.c_str());
+            if (g <= 0)
+                return false;
+            gamma(g);
+        } else if (name == "threshold") {
+            threshold(atoi(args.c_str()));
+        } else if (name == "gray") {
+            grayscale();
+        } else if (name == "blur") {
+            convolve(std::vector<float>(9, 1 / 9.0f), 3);
+        } else if (name == "gauss") {
+            convolve({ 1 / 16.0f, 2 / 16.0f, 1 / 16.0f,
+                       2 / 16.0f, 4 / 16.0f, 2 / 16.0f,
+                       1 / 16.0f, 2 / 16.0f, 1 / 16.0f }, 3);
+        } else if (name == "sharpen") {
+            convolve({ 0, -1, 0, -1, 5, -1, 0, -1, 0 }, 3);
+        } else if (name == "edge") {
+            convolve({ -1, -1, -1, -1, 8, -1, -1, -1, -1 }, 3);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// compose adjacent lookup tables into one
+std::vector<FilterChain::Stage> FilterChain::fused() const
+{
+    std::vector<Stage> stages;
+    for (const Stage &stage : m_stages) {
+        if (stage.type == LUT && !stages.empty() && stages.back().type == LUT) {
+            Stage &prev = stages.back();
+            for (int c = 0; c < 3; c++) {
+                for (int x = 0; x < 256; x++) {
+                    prev.lut[c][x] = stage.lut[c][prev.lut[c][x]];
+                }
+            }
+        } else {
+            stages.push_back(stage);
+        }
+    }
+    return stages;
+}
+
+int FilterChain::passes() const
+{
+    std::vector<Stage> stages = fused();
+    int convolutions = 0;
+    for (const Stage &stage : stages) {
+        if (stage.type == CONVOLVE)
+            convolutions++;
+    }
+    bool leading = !stages.empty() && stages.front().type != CONVOLVE;
+    return convolutions + ((leading || convolutions % 2) ? 1 : 0);
+}
+
+int FilterChain::halo() const
+{
+    int rows = 0;
+    for (const Stage &stage : m_stages) {
+        if (stage.type == CONVOLVE)
+            rows += stage.size / 2;
+    }
+    return rows;
+}
+
+void FilterChain::applyPoint(const Stage &stage, uint32_t *line, int width)
+{
+    if (stage.type == LUT) {
+        const uint8_t *r = stage.lut[0];
+        const uint8_t *g = stage.lut[1];
+        const uint8_t *b = stage.lut[2];
+        for (int x = 0; x < width; x++) {
+            uint32_t p = line[x];
+            line[x] = pack(r[(p >> 16) & 0xff], g[(p >> 8) & 0xff], b[p & 0xff]);
+        }
+    } else if (stage.type == GRAY) {
+        for (int x = 0; x < width; x++) {
+            uint32_t p = line[x];
+            // same weights as qGray()
+            int v = (((p >> 16) & 0xff) * 11 + ((p >> 8) & 0xff) * 16 + (p & 0xff) * 5) / 32;
+            line[x] = pack(v, v, v);
+        }
+    }
+}
+
+void FilterChain::convolveLine(const Stage &stage, const uint32_t *src, int src_stride,
+                               uint32_t *dst, int width, int height, int y)
+{
+    int half = stage.size / 2;
+    const float *k = stage.kernel.data();
+    for (int x = 0; x < width; x++) {
+        float r = 0, g = 0, b = 0;
+        for (int i = 0; i < stage.size; i++) {
+            int yy = std::min(std::max(y + i - half, 0), height - 1);
+            const uint32_t *line = src + (size_t) yy * src_stride;
+            for (int j = 0; j < stage.size; j++) {
+                int xx = std::min(std::max(x + j - half, 0), width - 1);
+                uint32_t p = line[xx];
+                float w = k[i * stage.size + j];
+                r += w * ((p >> 16) & 0xff);
+                g += w * ((p >> 8) & 0xff);
+                b += w * (p & 0xff);
+            }
+        }
+        dst[x] = pack(clamp_channel(std::lround(r)),
+                      clamp_channel(std::lround(g)),
+                      clamp_channel(std::lround(b)));
+    }
+}
+
+/*
+ * Each sweep reads one buffer and writes the other. The first sweep is
+ * done in place or out of place so that the last one lands in the image.
+ */
+void FilterChain::apply(uint32_t *bits, int width, int height, int stride,
+                        const RowExecutor &exec) const
+{
+    std::vector<Stage> stages = fused();
+    if (stages.empty())
+        return;
+
+    // pass boundaries: index of each convolution
+    std::vector<size_t> bounds;
+    for (size_t i = 0; i < stages.size(); i++) {
+        if (stages[i].type == CONVOLVE)
+            bounds.push_back(i);
+    }
+
+    std::vector<uint32_t> scratch;
+    if (!bounds.empty())
+        scratch.resize((size_t) width * height);
+
+    uint32_t *src = bits;
+    int src_stride = stride;
+    uint32_t *dst = bits;
+    int dst_stride = stride;
+    if (bounds.size() % 2) {
+        dst = scratch.data();
+        dst_stride = width;
+    }
+
+    // leading point-wise stages
+    size_t first = bounds.empty() ? stages.size() : bounds.front();
+    if (first > 0 || dst != src) {
+        exec(height, [&](int y0, int y1) {
+            for (int y = y0; y < y1; y++) {
+                uint32_t *out = dst + (size_t) y * dst_stride;
+                if (out != src + (size_t) y * src_stride)
+                    memcpy(out, src + (size_t) y * src_stride, width * sizeof(uint32_t));
+                for (size_t s = 0; s < first; s++)
+                    applyPoint(stages[s], out, width);
+            }
+        });
+    }
+
+    // one sweep per convolution, fused with the following point-wise stages
+    for (size_t b = 0; b < bounds.size(); b++) {
+        size_t begin = bounds[b];
+        size_t end = (b + 1 < bounds.size()) ? bounds[b + 1] : stages.size();
+        src = dst;
+        src_stride = dst_stride;
+        if (src == bits) {
+            dst = scratch.data();
+            dst_stride = width;
+        } else {
+            dst = bits;
+            dst_stride = stride;
+        }
+        exec(height, [&](int y0, int y1) {
+            for (int y = y0; y < y1; y++) {
+                uint32_t *out = dst + (size_t) y * dst_stride;
+                convolveLine(stages[begin], src, src_stride, out, width, height, y);
+                for (size_t s = begin + 1; s < end; s++)
+                    applyPoint(stages[s], out, width);
+            }
+        });
+    }
+}
+
+void FilterChain::applyUnfused(uint32_t *bits, int width, int height, int stride,
+                               const RowExecutor &exec) const
+{
+    std::vector<uint32_t> scratch;
+    for (const Stage &stage : m_stages) {
+        if (stage.type == CONVOLVE) {
+            scratch.resize((size_t) width * height);
+            exec(height, [&](int y0, int y1) {
+                for (int y = y0; y < y1; y++) {
+                    memcpy(scratch.data() + (size_t) y * width, bits + (size_t) y * stride,
+                           width * sizeof(uint32_t));
+                }
+            });
+            exec(height, [&](int y0, int y1) {
+                for (int y = y0; y < y1; y++) {
+                    convolveLine(stage, scratch.data(), width, bits + (size_t) y * stride,
+                                 width, height, y);
+                }
+            });
+        } else {
+            exec(height, [&](int y0, int y1) {
+                for (int y = y0; y < y1; y++) {
+                    applyPoint(stage, bits + (size_t) y * stride, width);
+                }
+            });
+        }
+    }
+}
+
+FilterChain::RowExecutor FilterChain::serial()
+{
+    return [](int rows, const RowBody &body) { body(0, rows); };
+}
@@ -0,0 +1,76 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+ * Chain of filters applied to a 0xAARRGGBB image (QImage::Format_RGB32).
+ *
+ * Point-wise stages (shift, gamma, threshold, grayscale) are fused: adjacent
+ * per-channel stages are composed into a single lookup table, and all the
+ * point-wise stages between two convolutions are applied row by row while
+ * the row is in cache. Only a convolution needs the previous stages to be
+ * complete on the whole image, so the image is swept once per convolution,
+ * plus once for the leading point-wise stages.
+ *
+ * The rows are partitioned by a RowExecutor, so the same chain runs on
+ * tbb::parallel_for or on std::thread.
+ */
+class FilterChain {
+public:
+    typedef std::function<void (int, int)> RowBody;
+    // calls body(y0, y1) over [0, rows), possibly in parallel
+    typedef std::function<void (int, const RowBody &)> RowExecutor;
+
+    FilterChain &shift(int dr, int dg, int db);
+    FilterChain &gamma(double gamma);
+    FilterChain &threshold(int level);
+    FilterChain &grayscale();
+    // arbitrary per channel table, red, green then blue
+    FilterChain &lut(const uint8_t table[3][256]);
+    // size x size kernel in row-major order, edges are clamped
+    FilterChain &convolve(const std::vector<float> &kernel, int size);
+
+    /*
+     * Parse a chain description such as "shift:20,0,0;gamma:2.2;gray;blur".
+     * Stages are shift:dr,dg,db, gamma:g, threshold:level, gray, and the
+     * 3x3 convolutions blur, gauss, sharpen and edge.
+     */
+    bool parse(const std::string &spec);
+
+    bool isEmpty() const { return m_stages.empty(); }
+    // number of sweeps over the whole image done by apply()
+    int passes() const;
+    // rows of neighbours needed above and below each row of the output
+    int halo() const;
+
+    void apply(uint32_t *bits, int width, int height, int stride,
+               const RowExecutor &exec) const;
+    // reference implementation, one sweep over the image per stage
+    void applyUnfused(uint32_t *bits, int width, int height, int stride,
+                      const RowExecutor &exec) const;
+
+    static RowExecutor serial();
+
+private:
+    enum StageType { LUT, GRAY, CONVOLVE };
+    struct Stage {
+        StageType type;
+        uint8_t lut[3][256];
+        std::vector<float> kernel;
+        int size;
+    };
+
+    Stage &lutStage();
+    std::vector<Stage> fused() const;
+    static void applyPoint(const Stage &stage, uint32_t *line, int width);
+    static void convolveLine(const Stage &stage, const uint32_t *src, int src_stride,
+                             uint32_t *dst, int width, int height, int y);
+
+    std::vector<Stage> m_stages;
+};
+
+#endif // FILTER_H
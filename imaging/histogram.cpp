@@ -0,0 +1,104 @@
+#include "histogram.h"
+
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+// consecutive equal pixels would serialize on the same counter, so each
+// channel is counted in 4 interleaved copies summed at the end
+static const int COPIES = 4;
+
+void histogram_build(const uint32_t *bits, int width, int height, int stride,
+                     Histogram &hist, const FilterChain::RowExecutor &exec)
+{
+    std::mutex lock;
+    memset(&hist, 0, sizeof(hist));
+    exec(height, [&](int y0, int y1) {
+        uint32_t local[COPIES][3][256];
+        memset(local, 0, sizeof(local));
+        for (int y = y0; y < y1; y++) {
+            const uint32_t *line = bits + (size_t) y * stride;
+            int x = 0;
+            for (; x + COPIES <= width; x += COPIES) {
+                for (int k = 0; k < COPIES; k++) {
+                    uint32_t p = line[x + k];
+                    local[k][0][(p >> 16) & 0xff]++;
+                    local[k][1][(p >> 8) & 0xff]++;
+                    local[k][2][p & 0xff]++;
+                }
+            }
+            for (; x < width; x++) {
+                uint32_t p = line[x];
+                local[0][0][(p >> 16) & 0xff]++;
+                local[0][1][(p >> 8) & 0xff]++;
+                local[0][2][p & 0xff]++;
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+        for (int k = 0; k < COPIES; k++) {
+            for (int c = 0; c < 3; c++) {
+                for (int v = 0; v < 256; v++) {
+                    hist.count[c][v] += local[k][c][v];
+                }
+            }
+        }
+        hist.total += (uint64_t) (y1 - y0) * width;
+    });
+}
+
+void histogram_cdf(const Histogram &hist, uint64_t cdf[3][256])
+{
+    for (int c = 0; c < 3; c++) {
+        uint64_t sum = 0;
+        for (int v = 0; v < 256; v++) {
+            sum += hist.count[c][v];
+            cdf[c][v] = sum;
+        }
+    }
+}
+
+void equalize_lut(const Histogram &hist, uint8_t lut[3][256])
+{
+    uint64_t cdf[3][256];
+    histogram_cdf(hist, cdf);
+    for (int c = 0; c < 3; c++) {
+        uint64_t min = 0;
+        for (int v = 0; v < 256 && min == 0; v++) {
+            min = cdf[c][v];
+        }
+        for (int v = 0; v < 256; v++) {
+            if (hist.total == min) {
+                lut[c][v] = v;      // single value, nothing to spread
+            } else if (cdf[c][v] < min) {
+                lut[c][v] = 0;
+            } else {
+                lut[c][v] = std::lround(255.0 * (cdf[c][v] - min) / (hist.total - min));
+            }
+        }
+    }
+}
+
+void levels_lut(const Histogram &hist, double clip, uint8_t lut[3][256])
+{
+    uint64_t cdf[3][256];
+    histogram_cdf(hist, cdf);
+    double low_count = clip * hist.total;
+    double high_count = (1.0 - clip) * hist.total;
+    for (int c = 0; c < 3; c++) {
+        int low = 0;
+        while (low < 255 && cdf[c][low] <= low_count)
+            low++;
+        int high = 255;
+        while (high > 0 && cdf[c][high - 1] >= high_count)
+            high--;
+        for (int v = 0; v < 256; v++) {
+            if (high <= low) {
+                lut[c][v] = v;
+            } else {
+                long x = std::lround(255.0 * (v - low) / (high - low));
+                lut[c][v] = x < 0 ? 0 : (x > 255 ? 255 : x);
+            }
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <cstdint>
+
+#include "filter.h"
+
+/*
+ * Per channel histograms of a 0xAARRGGBB image and the lookup tables of
+ * histogram equalisation and auto levels built from them. The tables are
+ * applied with FilterChain::lut(), fused with the other point-wise stages.
+ */
+struct Histogram {
+    uint64_t count[3][256];     // red, green, blue
+    uint64_t total;
+};
+
+/*
+ * One sweep over the image: each task counts its rows in a private
+ * histogram, merged into hist at the end of the task.
+ */
+void histogram_build(const uint32_t *bits, int width, int height, int stride,
+                     Histogram &hist, const FilterChain::RowExecutor &exec);
+
+// inclusive prefix sum of each channel
+void histogram_cdf(const Histogram &hist, uint64_t cdf[3][256]);
+
+// spread each channel so that its cumulative distribution becomes linear
+void equalize_lut(const Histogram &hist, uint8_t lut[3][256]);
+
+// stretch each channel between the clip and 1 - clip quantiles
+void levels_lut(const Histogram &hist, double clip, uint8_t lut[3][256]);
+
+#endif // HISTOGRAM_H
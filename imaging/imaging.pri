@@ -0,0 +1,24 @@
+# Image kernels shared by the image demos, independent of Qt.
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+HEADERS += \
+    $$PWD/pixel.h \
+    $$PWD/filter.h \
+    $$PWD/stream.h \
+    $$PWD/pngwriter.h \
+    $$PWD/histogram.h \
+    $$PWD/planar.h \
+    $$PWD/bench.h
+
+SOURCES += \
+    $$PWD/pixel.cpp \
+    $$PWD/filter.cpp \
+    $$PWD/stream.cpp \
+    $$PWD/pngwriter.cpp \
+    $$PWD/histogram.cpp \
+    $$PWD/planar.cpp \
+    $$PWD/bench.cpp
+
+LIBS += -lpng -lz
@@ -0,0 +1,90 @@
+#include "pixel.h"
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+static inline int clamp_delta(int d)
+{
+    return d < -255 ? -255 : (d > 255 ? 255 : d);
+}
+
+static inline int clamp_channel(int c)
+{
+    return c < 0 ? 0 : (c > 255 ? 255 : c);
+}
+
+void pixel_adjust_scalar(uint32_t *line, int len, int dr, int dg, int db)
+{
+    for (int x = 0; x < len; x++) {
+        uint32_t p = line[x];
+        int r = clamp_channel(((p >> 16) & 0xff) + dr);
+        int g = clamp_channel(((p >> 8) & 0xff) + dg);
+        int b = clamp_channel((p & 0xff) + db);
+        line[x] = 0xff000000u | (r << 16) | (g << 8) | b;
+    }
+}
+
+/*
+ * The deltas are split into a positive part added with unsigned saturation
+ * and a negative part subtracted with unsigned saturation. Per channel, one
+ * of the two is always zero.
+ */
+static inline uint32_t pack_delta(int dr, int dg, int db)
+{
+    dr = dr > 0 ? dr : 0;
+    dg = dg > 0 ? dg : 0;
+    db = db > 0 ? db : 0;
+    return (dr << 16) | (dg << 8) | db;
+}
+
+void pixel_adjust_sse2(uint32_t *line, int len, int dr, int dg, int db)
+{
+    dr = clamp_delta(dr); dg = clamp_delta(dg); db = clamp_delta(db);
+    __m128i add = _mm_set1_epi32(pack_delta(dr, dg, db));
+    __m128i sub = _mm_set1_epi32(pack_delta(-dr, -dg, -db));
+    __m128i alpha = _mm_set1_epi32(0xff000000);
+
+    int x = 0;
+    for (; x + 4 <= len; x += 4) {
+        __m128i p = _mm_loadu_si128((__m128i *) (line + x));
+        p = _mm_subs_epu8(_mm_adds_epu8(p, add), sub);
+        _mm_storeu_si128((__m128i *) (line + x), _mm_or_si128(p, alpha));
+    }
+    pixel_adjust_scalar(line + x, len - x, dr, dg, db);
+}
+
+__attribute__((target("avx2")))
+void pixel_adjust_avx2(uint32_t *line, int len, int dr, int dg, int db)
+{
+    dr = clamp_delta(dr); dg = clamp_delta(dg); db = clamp_delta(db);
+    __m256i add = _mm256_set1_epi32(pack_delta(dr, dg, db));
+    __m256i sub = _mm256_set1_epi32(pack_delta(-dr, -dg, -db));
+    __m256i alpha = _mm256_set1_epi32(0xff000000);
+
+    int x = 0;
+    for (; x + 8 <= len; x += 8) {
+        __m256i p = _mm256_loadu_si256((__m256i *) (line + x));
+        p = _mm256_subs_epu8(_mm256_adds_epu8(p, add), sub);
+        _mm256_storeu_si256((__m256i *) (line + x), _mm256_or_si256(p, alpha));
+    }
+    pixel_adjust_sse2(line + x, len - x, dr, dg, db);
+}
+
+PixelAdjust pixel_adjust_best()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return pixel_adjust_avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return pixel_adjust_sse2;
+    return pixel_adjust_scalar;
+}
+
+const char *pixel_adjust_name(PixelAdjust fn)
+{
+    if (fn == pixel_adjust_avx2)
+        return "avx2";
+    if (fn == pixel_adjust_sse2)
+        return "sse2";
+    return "scalar";
+}
@@ -0,0 +1,21 @@
+#ifndef PIXEL_H
+#define PIXEL_H
+
+#include <cstdint>
+
+/*
+ * Point-wise colour shift of a scanline of 0xAARRGGBB pixels (QRgb, as in
+ * QImage::Format_RGB32). Each channel is shifted by its delta and saturated
+ * to [0, 255], the alpha channel is set to 0xff like qRgb() does.
+ */
+typedef void (*PixelAdjust)(uint32_t *line, int len, int dr, int dg, int db);
+
+void pixel_adjust_scalar(uint32_t *line, int len, int dr, int dg, int db);
+void pixel_adjust_sse2(uint32_t *line, int len, int dr, int dg, int db);
+void pixel_adjust_avx2(uint32_t *line, int len, int dr, int dg, int db);
+
+// fastest implementation supported by the CPU, selected at runtime
+PixelAdjust pixel_adjust_best();
+const char *pixel_adjust_name(PixelAdjust fn);
+
+#endif // PIXEL_H
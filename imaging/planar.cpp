@@ -0,0 +1,159 @@
+#include "planar.h"
+
+#include <emmintrin.h>
+
+void PlanarImage::resize(int w, int h)
+{
+    width = w;
+    height = h;
+    stride = (w + 15) & ~15;
+    for (int c = 0; c < 3; c++) {
+        planes[c].resize((size_t) stride * h);
+    }
+}
+
+/*
+ * 16 pixels are deinterleaved at once: each channel is masked and shifted
+ * to the low byte of its 32 bits lane, then the 4 registers are packed to
+ * 16 bytes.
+ */
+static void split_row(const uint32_t *src, uint8_t *r, uint8_t *g, uint8_t *b, int width)
+{
+    const __m128i mask = _mm_set1_epi32(0xff);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i p[4];
+        for (int k = 0; k < 4; k++) {
+            p[k] = _mm_loadu_si128((const __m128i *) (src + x + 4 * k));
+        }
+        __m128i c[3][4];
+        for (int k = 0; k < 4; k++) {
+            c[0][k] = _mm_and_si128(_mm_srli_epi32(p[k], 16), mask);
+            c[1][k] = _mm_and_si128(_mm_srli_epi32(p[k], 8), mask);
+            c[2][k] = _mm_and_si128(p[k], mask);
+        }
+        uint8_t *dst[3] = { r, g, b };
+        for (int i = 0; i < 3; i++) {
+            __m128i lo = _mm_packs_epi32(c[i][0], c[i][1]);
+            __m128i hi = _mm_packs_epi32(c[i][2], c[i][3]);
+            _mm_storeu_si128((__m128i *) (dst[i] + x), _mm_packus_epi16(lo, hi));
+        }
+    }
+    for (; x < width; x++) {
+        r[x] = src[x] >> 16;
+        g[x] = src[x] >> 8;
+        b[x] = src[x];
+    }
+}
+
+// bytes B, G, R, A in memory are built with two levels of unpacking
+static void merge_row(const uint8_t *r, const uint8_t *g, const uint8_t *b, uint32_t *dst, int width)
+{
+    const __m128i alpha = _mm_set1_epi8((char) 0xff);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i vr = _mm_loadu_si128((const __m128i *) (r + x));
+        __m128i vg = _mm_loadu_si128((const __m128i *) (g + x));
+        __m128i vb = _mm_loadu_si128((const __m128i *) (b + x));
+        __m128i bg_lo = _mm_unpacklo_epi8(vb, vg);
+        __m128i bg_hi = _mm_unpackhi_epi8(vb, vg);
+        __m128i ra_lo = _mm_unpacklo_epi8(vr, alpha);
+        __m128i ra_hi = _mm_unpackhi_epi8(vr, alpha);
+        _mm_storeu_si128((__m128i *) (dst + x), _mm_unpacklo_epi16(bg_lo, ra_lo));
+        _mm_storeu_si128((__m128i *) (dst + x + 4), _mm_unpackhi_epi16(bg_lo, ra_lo));
+        _mm_storeu_si128((__m128i *) (dst + x + 8), _mm_unpacklo_epi16(bg_hi, ra_hi));
+        _mm_storeu_si128((__m128i *) (dst + x + 12), _mm_unpackhi_epi16(bg_hi, ra_hi));
+    }
+    for (; x < width; x++) {
+        dst[x] = 0xff000000u | (r[x] << 16) | (g[x] << 8) | b[x];
+    }
+}
+
+void planar_split(const uint32_t *bits, int width, int height, int stride,
+                  PlanarImage &img, const FilterChain::RowExecutor &exec)
+{
+    img.resize(width, height);
+    exec(height, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            split_row(bits + (size_t) y * stride, img.row(0, y), img.row(1, y), img.row(2, y), width);
+        }
+    });
+}
+
+void planar_merge(const PlanarImage &img, uint32_t *bits, int stride,
+                  const FilterChain::RowExecutor &exec)
+{
+    exec(img.height, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            merge_row(img.row(0, y), img.row(1, y), img.row(2, y), bits + (size_t) y * stride, img.width);
+        }
+    });
+}
+
+// the padding of the rows is processed too, it is never read back
+static void shift_plane(uint8_t *line, int len, int delta)
+{
+    delta = delta < -255 ? -255 : (delta > 255 ? 255 : delta);
+    __m128i add = _mm_set1_epi8((char) (delta > 0 ? delta : 0));
+    __m128i sub = _mm_set1_epi8((char) (delta < 0 ? -delta : 0));
+    for (int x = 0; x < len; x += 16) {
+        __m128i p = _mm_loadu_si128((__m128i *) (line + x));
+        _mm_storeu_si128((__m128i *) (line + x), _mm_subs_epu8(_mm_adds_epu8(p, add), sub));
+    }
+}
+
+void planar_shift(PlanarImage &img, int dr, int dg, int db, const FilterChain::RowExecutor &exec)
+{
+    int delta[3] = { dr, dg, db };
+    exec(img.height, [&](int y0, int y1) {
+        for (int c = 0; c < 3; c++) {
+            shift_plane(img.row(c, y0), (y1 - y0) * img.stride, delta[c]);
+        }
+    });
+}
+
+// (r * 11 + g * 16 + b * 5) / 32 like qGray(), on 16 bits lanes
+void planar_grayscale(PlanarImage &img, const FilterChain::RowExecutor &exec)
+{
+    exec(img.height, [&](int y0, int y1) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i wr = _mm_set1_epi16(11);
+        const __m128i wg = _mm_set1_epi16(16);
+        const __m128i wb = _mm_set1_epi16(5);
+        uint8_t *r = img.row(0, y0);
+        uint8_t *g = img.row(1, y0);
+        uint8_t *b = img.row(2, y0);
+        int len = (y1 - y0) * img.stride;
+        for (int x = 0; x < len; x += 16) {
+            __m128i vr = _mm_loadu_si128((__m128i *) (r + x));
+            __m128i vg = _mm_loadu_si128((__m128i *) (g + x));
+            __m128i vb = _mm_loadu_si128((__m128i *) (b + x));
+            __m128i lo = _mm_add_epi16(_mm_add_epi16(
+                    _mm_mullo_epi16(_mm_unpacklo_epi8(vr, zero), wr),
+                    _mm_mullo_epi16(_mm_unpacklo_epi8(vg, zero), wg)),
+                    _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb));
+            __m128i hi = _mm_add_epi16(_mm_add_epi16(
+                    _mm_mullo_epi16(_mm_unpackhi_epi8(vr, zero), wr),
+                    _mm_mullo_epi16(_mm_unpackhi_epi8(vg, zero), wg)),
+                    _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb));
+            __m128i v = _mm_packus_epi16(_mm_srli_epi16(lo, 5), _mm_srli_epi16(hi, 5));
+            _mm_storeu_si128((__m128i *) (r + x), v);
+            _mm_storeu_si128((__m128i *) (g + x), v);
+            _mm_storeu_si128((__m128i *) (b + x), v);
+        }
+    });
+}
+
+void planar_lut(PlanarImage &img, const uint8_t lut[3][256], const FilterChain::RowExecutor &exec)
+{
+    exec(img.height, [&](int y0, int y1) {
+        for (int c = 0; c < 3; c++) {
+            const uint8_t *table = lut[c];
+            uint8_t *line = img.row(c, y0);
+            int len = (y1 - y0) * img.stride;
+            for (int x = 0; x < len; x++) {
+                line[x] = table[line[x]];
+            }
+        }
+    });
+}
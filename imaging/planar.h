@@ -0,0 +1,37 @@
+#ifndef PLANAR_H
+#define PLANAR_H
+
+#include <cstdint>
+#include <vector>
+
+#include "filter.h"
+
+/*
+ * Planar (structure of arrays) image: one plane of bytes per channel, so
+ * that a 16 bytes register holds the same channel of 16 pixels instead of
+ * the 4 channels of 4 packed pixels. Rows are padded to 16 pixels.
+ */
+struct PlanarImage {
+    int width;
+    int height;
+    int stride;
+    std::vector<uint8_t> planes[3];     // red, green, blue
+
+    PlanarImage() : width(0), height(0), stride(0) { }
+    void resize(int w, int h);
+    uint8_t *row(int c, int y) { return planes[c].data() + (size_t) y * stride; }
+    const uint8_t *row(int c, int y) const { return planes[c].data() + (size_t) y * stride; }
+};
+
+// conversion from and to 0xAARRGGBB (QImage::Format_RGB32)
+void planar_split(const uint32_t *bits, int width, int height, int stride,
+                  PlanarImage &img, const FilterChain::RowExecutor &exec);
+void planar_merge(const PlanarImage &img, uint32_t *bits, int stride,
+                  const FilterChain::RowExecutor &exec);
+
+// same results as pixel_adjust_scalar(), FilterChain::grayscale() and lut()
+void planar_shift(PlanarImage &img, int dr, int dg, int db, const FilterChain::RowExecutor &exec);
+void planar_grayscale(PlanarImage &img, const FilterChain::RowExecutor &exec);
+void planar_lut(PlanarImage &img, const uint8_t lut[3][256], const FilterChain::RowExecutor &exec);
+
+#endif // PLANAR_H
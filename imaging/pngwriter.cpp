@@ -0,0 +1,212 @@
+#include "pngwriter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <zlib.h>
+
+static const size_t BAND_BYTES = 256 * 1024;
+static const size_t WINDOW = 32 * 1024;
+
+enum RowFilter { NONE, SUB, UP, AVERAGE, PAETH, FILTER_COUNT };
+
+struct Band {
+    size_t begin;
+    size_t end;
+    std::vector<uint8_t> deflated;
+    uLong adler;
+    uLong crc;
+    bool ok;
+};
+
+static inline uint8_t paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a);
+    int pb = abs(p - b);
+    int pc = abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    if (pb <= pc)
+        return b;
+    return c;
+}
+
+static void to_rgb(const uint32_t *src, uint8_t *dst, int width)
+{
+    for (int x = 0; x < width; x++, dst += 3) {
+        dst[0] = src[x] >> 16;
+        dst[1] = src[x] >> 8;
+        dst[2] = src[x];
+    }
+}
+
+/*
+ * Filter one row, keeping the filter with the smallest sum of absolute
+ * differences like libpng does. prev is NULL for the first row.
+ */
+static void filter_row(const uint8_t *row, const uint8_t *prev, uint8_t *out,
+                       uint8_t *scratch, size_t len)
+{
+    const int bpp = 3;
+    unsigned long best_sum = ~0UL;
+    for (int f = 0; f < FILTER_COUNT; f++) {
+        unsigned long sum = 0;
+        for (size_t i = 0; i < len; i++) {
+            int a = i >= bpp ? row[i - bpp] : 0;
+            int b = prev ? prev[i] : 0;
+            int c = prev && i >= bpp ? prev[i - bpp] : 0;
+            uint8_t v = row[i];
+            switch (f) {
+            case SUB: v -= a; break;
+            case UP: v -= b; break;
+            case AVERAGE: v -= (a + b) / 2; break;
+            case PAETH: v -= paeth(a, b, c); break;
+            }
+            scratch[i] = v;
+            sum += v < 128 ? v : 256 - v;
+        }
+        if (sum < best_sum) {
+            best_sum = sum;
+            out[0] = f;
+            std::copy(scratch, scratch + len, out + 1);
+        }
+    }
+}
+
+static bool deflate_band(const std::vector<uint8_t> &data, Band &band, int level, bool last)
+{
+    z_stream strm = z_stream();
+    // raw deflate, the zlib header and trailer are written once for all bands
+    if (deflateInit2(&strm, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+    if (band.begin > 0) {
+        size_t dict = std::min(WINDOW, band.begin);
+        deflateSetDictionary(&strm, data.data() + band.begin - dict, dict);
+    }
+    size_t len = band.end - band.begin;
+    band.deflated.resize(deflateBound(&strm, len) + 16);
+    strm.next_in = (Bytef *) data.data() + band.begin;
+    strm.avail_in = len;
+    strm.next_out = band.deflated.data();
+    strm.avail_out = band.deflated.size();
+    // a sync flush ends the band on a byte boundary so that bands concatenate
+    int ret = deflate(&strm, last ? Z_FINISH : Z_SYNC_FLUSH);
+    band.ok = last ? ret == Z_STREAM_END : (ret == Z_OK && strm.avail_in == 0);
+    band.deflated.resize(strm.total_out);
+    deflateEnd(&strm);
+
+    band.adler = adler32(1L, data.data() + band.begin, len);
+    band.crc = crc32(0L, band.deflated.data(), band.deflated.size());
+    return band.ok;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static bool write_chunk(FILE *file, const char *type, const uint8_t *data, uint32_t len)
+{
+    uint8_t head[8];
+    uint8_t tail[4];
+    put32(head, len);
+    std::copy(type, type + 4, head + 4);
+    uLong crc = crc32(0L, head + 4, 4);
+    if (len > 0)
+        crc = crc32(crc, data, len);    // crc32() with no data returns its initial value
+    put32(tail, crc);
+    return fwrite(head, 1, 8, file) == 8 &&
+            fwrite(data, 1, len, file) == len &&
+            fwrite(tail, 1, 4, file) == 4;
+}
+
+bool write_png_parallel(const std::string &path, const uint32_t *bits,
+                        int width, int height, int stride,
+                        const FilterChain::RowExecutor &exec, int level)
+{
+    size_t row_len = 3 * (size_t) width;
+    size_t line = row_len + 1;
+    std::vector<uint8_t> filtered(line * height);
+
+    // filter rows, each task converts its rows and the one above
+    exec(height, [&](int begin, int end) {
+        std::vector<uint8_t> prev(row_len);
+        std::vector<uint8_t> row(row_len);
+        std::vector<uint8_t> scratch(row_len);
+        if (begin > 0)
+            to_rgb(bits + (size_t) (begin - 1) * stride, prev.data(), width);
+        for (int y = begin; y < end; y++) {
+            to_rgb(bits + (size_t) y * stride, row.data(), width);
+            filter_row(row.data(), y > 0 ? prev.data() : nullptr,
+                       filtered.data() + y * line, scratch.data(), row_len);
+            row.swap(prev);
+        }
+    });
+
+    size_t band_rows = std::max<size_t>(1, BAND_BYTES / line);
+    std::vector<Band> bands((height + band_rows - 1) / band_rows);
+    for (size_t i = 0; i < bands.size(); i++) {
+        bands[i].begin = i * band_rows * line;
+        bands[i].end = std::min(filtered.size(), (i + 1) * band_rows * line);
+    }
+    exec(bands.size(), [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            deflate_band(filtered, bands[i], level, i + 1 == (int) bands.size());
+        }
+    });
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    uint8_t ihdr[13];
+    put32(ihdr, width);
+    put32(ihdr + 4, height);
+    ihdr[8] = 8;        // bit depth
+    ihdr[9] = 2;        // RGB
+    ihdr[10] = 0;       // deflate
+    ihdr[11] = 0;       // adaptive filtering
+    ihdr[12] = 0;       // no interlace
+    bool ok = fwrite(signature, 1, 8, file) == 8 && write_chunk(file, "IHDR", ihdr, 13);
+
+    // one IDAT per band, the zlib header goes in the first and the adler32 in the last
+    static const uint8_t zlib_header[2] = { 0x78, 0x9c };
+    uLong adler = 1L;
+    for (size_t i = 0; ok && i < bands.size(); i++) {
+        const Band &band = bands[i];
+        bool first = i == 0;
+        bool last = i + 1 == bands.size();
+        ok = band.ok;
+        adler = adler32_combine(adler, band.adler, band.end - band.begin);
+
+        uint8_t trailer[4];
+        put32(trailer, adler);
+        uint32_t len = band.deflated.size() + (first ? 2 : 0) + (last ? 4 : 0);
+        uint8_t head[8];
+        put32(head, len);
+        std::copy("IDAT", "IDAT" + 4, head + 4);
+        uLong crc = crc32(0L, head + 4, 4);
+        if (first)
+            crc = crc32(crc, zlib_header, 2);
+        crc = crc32_combine(crc, band.crc, band.deflated.size());
+        if (last)
+            crc = crc32(crc, trailer, 4);
+        uint8_t tail[4];
+        put32(tail, crc);
+
+        ok = ok && fwrite(head, 1, 8, file) == 8;
+        ok = ok && (!first || fwrite(zlib_header, 1, 2, file) == 2);
+        ok = ok && fwrite(band.deflated.data(), 1, band.deflated.size(), file) == band.deflated.size();
+        ok = ok && (!last || fwrite(trailer, 1, 4, file) == 4);
+        ok = ok && fwrite(tail, 1, 4, file) == 4;
+    }
+
+    ok = ok && write_chunk(file, "IEND", nullptr, 0);
+    return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,20 @@
+#ifndef PNGWRITER_H
+#define PNGWRITER_H
+
+#include <cstdint>
+#include <string>
+
+#include "filter.h"
+
+/*
+ * Write a 0xAARRGGBB image as an 8 bits RGB PNG. Rows are filtered and
+ * bands of rows are deflated concurrently with exec, as independent deflate
+ * streams flushed on a byte boundary and concatenated (like pigz). Each band
+ * is primed with the 32 KiB preceding it, the adler32 of the zlib stream and
+ * the CRC of the chunks are combined from the bands.
+ */
+bool write_png_parallel(const std::string &path, const uint32_t *bits,
+                        int width, int height, int stride,
+                        const FilterChain::RowExecutor &exec, int level = 6);
+
+#endif // PNGWRITER_H
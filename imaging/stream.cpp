@@ -0,0 +1,280 @@
+#include "stream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <png.h>
+
+static bool has_suffix(const std::string &path, const std::string &suffix)
+{
+    return path.size() >= suffix.size() &&
+            path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/*
+ * libpng reports errors with longjmp() to the setjmp() of the caller, so
+ * every method calling libpng sets it.
+ */
+class PngReader : public StripReader {
+public:
+    PngReader() : m_file(nullptr), m_png(nullptr), m_info(nullptr) { }
+    ~PngReader() {
+        if (m_png)
+            png_destroy_read_struct(&m_png, &m_info, nullptr);
+        if (m_file)
+            fclose(m_file);
+    }
+
+    bool open(const std::string &path) {
+        if ((m_file = fopen(path.c_str(), "rb")) == nullptr)
+            return false;
+        m_png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+        if (m_png == nullptr)
+            return false;
+        m_info = png_create_info_struct(m_png);
+        if (m_info == nullptr)
+            return false;
+        if (setjmp(png_jmpbuf(m_png)))
+            return false;
+        png_init_io(m_png, m_file);
+        png_read_info(m_png, m_info);
+        if (png_get_interlace_type(m_png, m_info) != PNG_INTERLACE_NONE) {
+            fprintf(stderr, "%s: interlaced PNG can't be streamed\n", path.c_str());
+            return false;
+        }
+        // any PNG to 8 bits B, G, R, A in memory, that is 0xAARRGGBB
+        png_set_expand(m_png);
+        png_set_strip_16(m_png);
+        png_set_gray_to_rgb(m_png);
+        png_set_bgr(m_png);
+        png_set_filler(m_png, 0xff, PNG_FILLER_AFTER);
+        png_read_update_info(m_png, m_info);
+        m_width = png_get_image_width(m_png, m_info);
+        m_height = png_get_image_height(m_png, m_info);
+        return true;
+    }
+
+    bool readRows(uint32_t *dst, int rows, int stride) {
+        if (setjmp(png_jmpbuf(m_png)))
+            return false;
+        for (int y = 0; y < rows; y++) {
+            png_read_row(m_png, (png_bytep) (dst + (size_t) y * stride), nullptr);
+        }
+        return true;
+    }
+
+private:
+    FILE *m_file;
+    png_structp m_png;
+    png_infop m_info;
+};
+
+class PngWriter : public StripWriter {
+public:
+    PngWriter() : m_file(nullptr), m_png(nullptr), m_info(nullptr) { }
+    ~PngWriter() {
+        if (m_png)
+            png_destroy_write_struct(&m_png, &m_info);
+        if (m_file)
+            fclose(m_file);
+    }
+
+    bool create(const std::string &path, int width, int height) {
+        if ((m_file = fopen(path.c_str(), "wb")) == nullptr)
+            return false;
+        m_png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+        if (m_png == nullptr)
+            return false;
+        m_info = png_create_info_struct(m_png);
+        if (m_info == nullptr)
+            return false;
+        if (setjmp(png_jmpbuf(m_png)))
+            return false;
+        png_init_io(m_png, m_file);
+        png_set_IHDR(m_png, m_info, width, height, 8, PNG_COLOR_TYPE_RGB,
+                     PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+        png_write_info(m_png, m_info);
+        // drop the alpha byte of 0xAARRGGBB
+        png_set_bgr(m_png);
+        png_set_filler(m_png, 0, PNG_FILLER_AFTER);
+        return true;
+    }
+
+    bool writeRows(const uint32_t *src, int rows, int stride) {
+        if (setjmp(png_jmpbuf(m_png)))
+            return false;
+        for (int y = 0; y < rows; y++) {
+            png_write_row(m_png, (png_const_bytep) (src + (size_t) y * stride));
+        }
+        return true;
+    }
+
+    bool finish() {
+        if (setjmp(png_jmpbuf(m_png)))
+            return false;
+        png_write_end(m_png, nullptr);
+        return fflush(m_file) == 0;
+    }
+
+private:
+    FILE *m_file;
+    png_structp m_png;
+    png_infop m_info;
+};
+
+class PpmReader : public StripReader {
+public:
+    PpmReader() : m_file(nullptr) { }
+    ~PpmReader() {
+        if (m_file)
+            fclose(m_file);
+    }
+
+    bool open(const std::string &path) {
+        int maxval;
+        if ((m_file = fopen(path.c_str(), "rb")) == nullptr)
+            return false;
+        if (fscanf(m_file, "P6 %d %d %d", &m_width, &m_height, &maxval) != 3 || maxval != 255) {
+            fprintf(stderr, "%s: only binary PPM with 8 bits channels is supported\n", path.c_str());
+            return false;
+        }
+        fgetc(m_file); // single whitespace before the pixels
+        m_line.resize(3 * (size_t) m_width);
+        return true;
+    }
+
+    bool readRows(uint32_t *dst, int rows, int stride) {
+        for (int y = 0; y < rows; y++) {
+            if (fread(m_line.data(), 3, m_width, m_file) != (size_t) m_width)
+                return false;
+            uint32_t *out = dst + (size_t) y * stride;
+            const uint8_t *p = m_line.data();
+            for (int x = 0; x < m_width; x++, p += 3) {
+                out[x] = 0xff000000u | (p[0] << 16) | (p[1] << 8) | p[2];
+            }
+        }
+        return true;
+    }
+
+private:
+    FILE *m_file;
+    std::vector<uint8_t> m_line;
+};
+
+class PpmWriter : public StripWriter {
+public:
+    PpmWriter() : m_file(nullptr), m_width(0) { }
+    ~PpmWriter() {
+        if (m_file)
+            fclose(m_file);
+    }
+
+    bool create(const std::string &path, int width, int height) {
+        if ((m_file = fopen(path.c_str(), "wb")) == nullptr)
+            return false;
+        m_width = width;
+        m_line.resize(3 * (size_t) width);
+        return fprintf(m_file, "P6\n%d %d\n%d\n", width, height, 255) > 0;
+    }
+
+    bool writeRows(const uint32_t *src, int rows, int stride) {
+        for (int y = 0; y < rows; y++) {
+            const uint32_t *in = src + (size_t) y * stride;
+            uint8_t *p = m_line.data();
+            for (int x = 0; x < m_width; x++, p += 3) {
+                p[0] = in[x] >> 16;
+                p[1] = in[x] >> 8;
+                p[2] = in[x];
+            }
+            if (fwrite(m_line.data(), 3, m_width, m_file) != (size_t) m_width)
+                return false;
+        }
+        return true;
+    }
+
+    bool finish() {
+        return fflush(m_file) == 0;
+    }
+
+private:
+    FILE *m_file;
+    int m_width;
+    std::vector<uint8_t> m_line;
+};
+
+StripReader *StripReader::open(const std::string &path)
+{
+    if (has_suffix(path, ".ppm") || has_suffix(path, ".pnm")) {
+        PpmReader *reader = new PpmReader();
+        if (reader->open(path))
+            return reader;
+        delete reader;
+    } else {
+        PngReader *reader = new PngReader();
+        if (reader->open(path))
+            return reader;
+        delete reader;
+    }
+    return nullptr;
+}
+
+StripWriter *StripWriter::create(const std::string &path, int width, int height)
+{
+    if (has_suffix(path, ".ppm")) {
+        PpmWriter *writer = new PpmWriter();
+        if (writer->create(path, width, height))
+            return writer;
+        delete writer;
+    } else {
+        PngWriter *writer = new PngWriter();
+        if (writer->create(path, width, height))
+            return writer;
+        delete writer;
+    }
+    return nullptr;
+}
+
+StripSource::StripSource(StripReader *reader, int strip_rows, int halo) :
+    m_reader(reader), m_strip_rows(strip_rows), m_halo(halo), m_y(0), m_read(0),
+    m_failed(false), m_carry_first(0)
+{
+}
+
+bool StripSource::next(Strip &strip)
+{
+    int width = m_reader->width();
+    int height = m_reader->height();
+    if (m_y >= height || m_failed)
+        return false;
+
+    int rows = std::min(m_strip_rows, height - m_y);
+    int first = std::max(0, m_y - m_halo);
+    int last = std::min(height, m_y + rows + m_halo);
+
+    strip.y = m_y;
+    strip.rows = rows;
+    strip.top = m_y - first;
+    strip.total = last - first;
+    strip.width = width;
+    strip.pixels.resize((size_t) strip.total * width);
+
+    // halo rows above, already read for the previous strip
+    int carried = m_read - first;
+    if (carried > 0) {
+        memcpy(strip.pixels.data(),
+               m_carry.data() + (size_t) (first - m_carry_first) * width,
+               (size_t) carried * width * sizeof(uint32_t));
+    }
+    if (!m_reader->readRows(strip.pixels.data() + (size_t) carried * width, last - m_read, width)) {
+        m_failed = true;
+        return false;
+    }
+    m_read = last;
+
+    // keep the rows needed by the halo of the next strip
+    int keep = std::max(0, m_read - std::max(first, m_y + rows - m_halo));
+    m_carry_first = m_read - keep;
+    m_carry.assign(strip.pixels.end() - (size_t) keep * width, strip.pixels.end());
+
+    m_y += rows;
+    return true;
+}
@@ -0,0 +1,76 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*
+ * Row by row decoding and encoding of images too large to fit in memory.
+ * Pixels are 0xAARRGGBB (QImage::Format_RGB32). PNG (non interlaced) is
+ * handled with libpng, PPM (P6) directly.
+ */
+class StripReader {
+public:
+    virtual ~StripReader() { }
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    // decode the next rows of the image
+    virtual bool readRows(uint32_t *dst, int rows, int stride) = 0;
+    // format selected by extension, NULL on error
+    static StripReader *open(const std::string &path);
+protected:
+    StripReader() : m_width(0), m_height(0) { }
+    int m_width;
+    int m_height;
+};
+
+class StripWriter {
+public:
+    virtual ~StripWriter() { }
+    virtual bool writeRows(const uint32_t *src, int rows, int stride) = 0;
+    virtual bool finish() = 0;
+    // .ppm is written as PPM, anything else as PNG
+    static StripWriter *create(const std::string &path, int width, int height);
+};
+
+/*
+ * Horizontal strip of the image. The rows [y, y + rows) are the output of
+ * the strip, they are preceded by top halo rows and followed by the bottom
+ * halo rows, fewer at the edges of the image.
+ */
+struct Strip {
+    int y;
+    int rows;
+    int top;
+    int total;
+    int width;
+    std::vector<uint32_t> pixels;
+
+    uint32_t *output() { return pixels.data() + (size_t) top * width; }
+};
+
+/*
+ * Cut the image in strips of strip_rows rows, each with halo rows above and
+ * below so that neighbourhood filters see the same pixels as on the whole
+ * image. Only the halo rows are kept between two strips.
+ */
+class StripSource {
+public:
+    StripSource(StripReader *reader, int strip_rows, int halo);
+    // false when the image is done or on error, see failed()
+    bool next(Strip &strip);
+    bool failed() const { return m_failed; }
+private:
+    StripReader *m_reader;
+    int m_strip_rows;
+    int m_halo;
+    int m_y;
+    int m_read;
+    bool m_failed;
+    int m_carry_first;
+    std::vector<uint32_t> m_carry;
+};
+
+#endif // STREAM_H
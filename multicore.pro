@@ -3,6 +3,7 @@ TEMPLATE = subdirs
 SUBDIRS += \
     01-pthread-image \
     02-dispatch \
+    dispatch-analyze \
     10-cpp-lambda \
     11-tbb-parallel-for \
     12-tbb-parallel-reduce \
@@ -0,0 +1,12 @@
+# Online tuning of the grain size and partitioner of tbb::parallel_for.
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+HEADERS += \
+    $$PWD/tuned_loop.h
+
+SOURCES += \
+    $$PWD/tuned_loop.cpp
+
+LIBS += -ltbb
@@ -0,0 +1,205 @@
+#include "tuned_loop.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+static const TuneChoice CANDIDATES[] = {
+    { TUNE_AUTO, 0 },
+    { TUNE_SIMPLE, 4 },
+    { TUNE_SIMPLE, 16 },
+    { TUNE_SIMPLE, 64 },
+    { TUNE_AFFINITY, 0 },
+    { TUNE_STATIC, 0 },
+};
+static const int NCANDIDATES = sizeof(CANDIDATES) / sizeof(CANDIDATES[0]);
+
+static const char *PARTITIONER_NAMES[] = { "auto", "simple", "affinity", "static" };
+
+size_t TuneChoice::grain(size_t n, int threads) const
+{
+    if (chunks_per_thread <= 0)
+        return 1;
+    size_t chunks = (size_t) max(threads, 1) * chunks_per_thread;
+    return max<size_t>(n / chunks, 1);
+}
+
+string TuneChoice::toString() const
+{
+    ostringstream s;
+    s << PARTITIONER_NAMES[partitioner];
+    if (chunks_per_thread > 0)
+        s << "/" << chunks_per_thread;
+    return s.str();
+}
+
+/*
+ * Winners of all the loops of the process, keyed by "name threads class".
+ * The file has one winner per line:
+ * name threads class partitioner chunks_per_thread
+ */
+struct TuneStore {
+    mutex lock;
+    bool loaded;
+    map<string, TuneChoice> winners;
+
+    TuneStore() : loaded(false) { }
+};
+
+static TuneStore &store()
+{
+    static TuneStore s;
+    return s;
+}
+
+static string storeKey(const string &name, pair<int, int> key)
+{
+    return name + " " + to_string(key.first) + " " + to_string(key.second);
+}
+
+static void loadStore(TuneStore &s)
+{
+    s.loaded = true;
+    const char *path = getenv("TBBTUNE_FILE");
+    if (!path)
+        return;
+    ifstream in(path);
+    string line;
+    while (getline(in, line)) {
+        istringstream fields(line);
+        string name, partitioner;
+        pair<int, int> key;
+        TuneChoice choice;
+        if (!(fields >> name >> key.first >> key.second >> partitioner >> choice.chunks_per_thread))
+            continue;
+        const char **found = find(begin(PARTITIONER_NAMES), end(PARTITIONER_NAMES), partitioner);
+        if (found == end(PARTITIONER_NAMES))
+            continue;
+        choice.partitioner = (TunePartitioner) (found - PARTITIONER_NAMES);
+        s.winners[storeKey(name, key)] = choice;
+    }
+}
+
+static void saveStore(TuneStore &s)
+{
+    const char *path = getenv("TBBTUNE_FILE");
+    if (!path)
+        return;
+    ofstream out(path);
+    for (const auto &entry : s.winners) {
+        out << entry.first << " " << PARTITIONER_NAMES[entry.second.partitioner]
+            << " " << entry.second.chunks_per_thread << "\n";
+    }
+}
+
+TunedLoop::TunedLoop(const string &name, int trials) :
+    m_name(name), m_trials(max(trials, 1))
+{
+}
+
+// concurrency of the current arena and floor(log2(n))
+static pair<int, int> sizeClassOf(size_t n)
+{
+    int cls = 0;
+    while (cls < 63 && ((size_t) 2 << cls) <= n)
+        cls++;
+    return make_pair(tbb::this_task_arena::max_concurrency(), cls);
+}
+
+TunedLoop::SizeClass &TunedLoop::sizeClass(size_t n)
+{
+    pair<int, int> key = sizeClassOf(n);
+    lock_guard<mutex> lock(m_mutex);
+    unique_ptr<SizeClass> &sc = m_classes[key];
+    if (!sc) {
+        sc.reset(new SizeClass());
+        sc->next = 0;
+        sc->measured = 0;
+        sc->tuned = false;
+        sc->affinity_busy = false;
+        fill(begin(sc->best), end(sc->best), -1.0);
+
+        TuneStore &s = store();
+        lock_guard<mutex> store_lock(s.lock);
+        if (!s.loaded)
+            loadStore(s);
+        auto it = s.winners.find(storeKey(m_name, key));
+        sc->seconds = -1;
+        if (it != s.winners.end()) {
+            sc->winner = it->second;
+            sc->tuned = true;
+        }
+    }
+    return *sc;
+}
+
+TuneChoice TunedLoop::select(SizeClass &sc, int &candidate)
+{
+    lock_guard<mutex> lock(m_mutex);
+    TuneChoice choice;
+    if (sc.tuned) {
+        candidate = -1;
+        choice = sc.winner;
+    } else {
+        candidate = sc.next % NCANDIDATES;
+        choice = CANDIDATES[candidate];
+    }
+    if (choice.partitioner == TUNE_AFFINITY) {
+        if (sc.affinity_busy) {
+            // the affinity candidate stays next in line
+            candidate = -1;
+            choice.partitioner = TUNE_AUTO;
+        } else {
+            sc.affinity_busy = true;
+        }
+    }
+    // concurrent calls time different candidates
+    if (candidate >= 0)
+        sc.next++;
+    return choice;
+}
+
+void TunedLoop::finish(SizeClass &sc, size_t n, const TuneChoice &choice, int candidate,
+                       double seconds)
+{
+    lock_guard<mutex> lock(m_mutex);
+    if (choice.partitioner == TUNE_AFFINITY)
+        sc.affinity_busy = false;
+    if (candidate < 0 || sc.tuned)
+        return;
+    if (sc.best[candidate] < 0 || seconds < sc.best[candidate])
+        sc.best[candidate] = seconds;
+    if (++sc.measured < NCANDIDATES * m_trials)
+        return;
+
+    // the candidates no call has measured yet are still at -1
+    int winner = candidate;
+    for (int i = 0; i < NCANDIDATES; i++) {
+        if (sc.best[i] >= 0 && sc.best[i] < sc.best[winner])
+            winner = i;
+    }
+    sc.winner = CANDIDATES[winner];
+    sc.seconds = sc.best[winner];
+    sc.tuned = true;
+
+    TuneStore &s = store();
+    lock_guard<mutex> store_lock(s.lock);
+    s.winners[storeKey(m_name, sizeClassOf(n))] = sc.winner;
+    saveStore(s);
+}
+
+bool TunedLoop::tuned(size_t n, TuneChoice &choice, double *seconds)
+{
+    // looks up the persisted winners too
+    SizeClass &sc = sizeClass(n);
+    lock_guard<mutex> lock(m_mutex);
+    if (!sc.tuned)
+        return false;
+    choice = sc.winner;
+    if (seconds)
+        *seconds = sc.seconds;
+    return true;
+}
@@ -0,0 +1,119 @@
+#ifndef TUNED_LOOP_H
+#define TUNED_LOOP_H
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tbb/tbb.h>
+
+/*
+ * tbb::parallel_for with a grain size and partitioner tuned online.
+ *
+ * The first invocations of a loop cycle through a few candidates (auto,
+ * simple with 4, 16 and 64 chunks per thread, affinity and static), each
+ * timed a few times. The fastest is then used for every later call. The
+ * winner depends on the trip count and on the number of threads, so it is
+ * kept per size class, the power of two of the range length, and per
+ * concurrency of the current arena.
+ *
+ * Winners are kept for the process, and persisted when TBBTUNE_FILE names
+ * a file: it is read at the first lookup and rewritten when a loop has
+ * been tuned, so that the next runs on the same machine skip the tuning.
+ *
+ * A loop is identified by its name, typically a static TunedLoop next to
+ * the parallel_for it replaces. Concurrent calls are allowed: each one
+ * claims the next candidate, and a candidate that no call has measured
+ * cannot win. The affinity partitioner keeps state between calls and is
+ * used by one call at a time: the others fall back to the auto
+ * partitioner and are not measured.
+ *
+ * The tuning calls are themselves timed with rotating partitioners: a
+ * benchmark tunes its loops before the timed region, calling them until
+ * tuned() returns true.
+ */
+enum TunePartitioner {
+    TUNE_AUTO,
+    TUNE_SIMPLE,
+    TUNE_AFFINITY,
+    TUNE_STATIC,
+};
+
+struct TuneChoice {
+    TunePartitioner partitioner;
+    // grain is n / (threads * chunks_per_thread), grain 1 when zero
+    int chunks_per_thread;
+
+    size_t grain(size_t n, int threads) const;
+    std::string toString() const;
+};
+
+class TunedLoop {
+public:
+    explicit TunedLoop(const std::string &name, int trials = 2);
+
+    template<typename Index, typename Body>
+    void parallel_for(Index begin, Index end, const Body &body);
+
+    const std::string &name() const { return m_name; }
+    // the choice for this trip count in the current arena, false while it is being tuned.
+    // seconds receives the best time of the winner, -1 when it was read from TBBTUNE_FILE
+    bool tuned(size_t n, TuneChoice &choice, double *seconds = nullptr);
+
+private:
+    struct SizeClass {
+        int next;       // candidates handed out, while tuning
+        int measured;   // measurements completed, while tuning
+        double best[8]; // -1 until measured
+        bool tuned;
+        bool affinity_busy;
+        TuneChoice winner;
+        double seconds; // best time of the winner, -1 when persisted
+        tbb::affinity_partitioner affinity;
+    };
+
+    SizeClass &sizeClass(size_t n);
+    // choice for this call, candidate is -1 when the call is not measured
+    TuneChoice select(SizeClass &sc, int &candidate);
+    void finish(SizeClass &sc, size_t n, const TuneChoice &choice, int candidate, double seconds);
+
+    std::string m_name;
+    int m_trials;
+    std::mutex m_mutex;
+    // by concurrency, then size class
+    std::map<std::pair<int, int>, std::unique_ptr<SizeClass>> m_classes;
+};
+
+template<typename Index, typename Body>
+void TunedLoop::parallel_for(Index begin, Index end, const Body &body)
+{
+    if (!(begin < end))
+        return;
+    size_t n = end - begin;
+    SizeClass &sc = sizeClass(n);
+    int candidate;
+    TuneChoice choice = select(sc, candidate);
+    tbb::blocked_range<Index> range(begin, end,
+                                    choice.grain(n, tbb::this_task_arena::max_concurrency()));
+
+    auto t0 = std::chrono::steady_clock::now();
+    switch (choice.partitioner) {
+    case TUNE_SIMPLE:
+        tbb::parallel_for(range, body, tbb::simple_partitioner());
+        break;
+    case TUNE_AFFINITY:
+        tbb::parallel_for(range, body, sc.affinity);
+        break;
+    case TUNE_STATIC:
+        tbb::parallel_for(range, body, tbb::static_partitioner());
+        break;
+    default:
+        tbb::parallel_for(range, body, tbb::auto_partitioner());
+        break;
+    }
+    std::chrono::duration<double> t = std::chrono::steady_clock::now() - t0;
+    finish(sc, n, choice, candidate, t.count());
+}
+
+#endif // TUNED_LOOP_H